@@ -0,0 +1,229 @@
+/**
+ * Benchmark of training, flattening and classification of the decision tree
+ * with synthetic categorical data
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        dtbench.cc
+ */
+
+#include "decisiontree.h"
+#include "flattree.h"
+#include "forest.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <sys/resource.h>
+
+struct {
+    int num_rows = 100000; // number of training tuples
+    int num_test_rows = 100000; // number of test tuples
+    int num_attrs = 10; // number of attributes except the one being classified
+    int cardinality = 5; // number of classes of each attribute
+    int num_labels = 2; // number of classes being classified
+    double noise = 0.05; // probability of replacing the class with a random one
+    int num_trees = 0; // number of trees of the forest, 0 means a single decision tree
+    int num_threads = 0; // number of threads for training the forest
+    unsigned int seed = 1; // seed of the data and the forest
+    Criterion criterion = Criterion::GAIN_RATIO; // split criterion of the trees
+} g_bench_config;
+
+/**
+ * Peak resident set size of the process in KB
+ */
+long PeakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Print one phase of the benchmark as a CSV row
+ *
+ * @param[in]   phase       name of the phase
+ * @param[in]   seconds     elapsed time
+ * @param[in]   items       number of processed items (nodes or tuples)
+ */
+void PrintPhase(const char *phase, double seconds, long items) {
+    printf("%d,%d,%d,%d,%.3f,%d,%s,%.6f,%ld,%.1f,%ld\n",
+            g_bench_config.num_rows, g_bench_config.num_attrs, g_bench_config.cardinality,
+            g_bench_config.num_labels, g_bench_config.noise, g_bench_config.num_trees,
+            phase, seconds, items, seconds > 0 ? items / seconds : 0.0, PeakRSS());
+}
+
+double Elapsed(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+/**
+ * Generate the synthetic data set
+ * The class being classified is decided by the first few attributes, then replaced
+ * by a random class with the noise probability
+ *
+ * @param[in]   rng         random source
+ * @param[in]   num_rows    number of tuples
+ * @param[out]  data        generated data set
+ */
+void GenerateData(mt19937 &rng, int num_rows, Dataset &data) {
+    int num_attrs = g_bench_config.num_attrs;
+    int cardinality = g_bench_config.cardinality;
+    int num_labels = g_bench_config.num_labels;
+    int num_rule_attrs = min(num_attrs, 3);
+    char name[32];
+
+    // classes are zero padded so that the sorted order is the index order
+    data = Dataset();
+    data.num_attrs = num_attrs + 1;
+    data.num_rows = num_rows;
+    data.class_of_attr.resize(data.num_attrs);
+    for (int i = 0; i <= num_attrs; i++) {
+        int num_classes = i < num_attrs ? cardinality : num_labels;
+        snprintf(name, sizeof(name), i < num_attrs ? "a%d" : "label", i);
+        data.attributes.push_back(name);
+        for (int j = 0; j < num_classes; j++) {
+            snprintf(name, sizeof(name), "c%06d", j);
+            data.class_of_attr[i].push_back(name);
+        }
+    }
+
+    uniform_int_distribution<int> attr_dist(0, cardinality - 1);
+    uniform_int_distribution<int> label_dist(0, num_labels - 1);
+    uniform_real_distribution<double> noise_dist(0.0, 1.0);
+    data.codes.resize((size_t)num_rows * data.num_attrs);
+    for (int row = 0; row < num_rows; row++) {
+        int *tuple = &data.codes[(size_t)row * data.num_attrs];
+        unsigned int rule = 0;
+        for (int i = 0; i < num_attrs; i++) {
+            tuple[i] = attr_dist(rng);
+            if (i < num_rule_attrs) {
+                rule = rule * 31 + tuple[i];
+            }
+        }
+        tuple[num_attrs] = (rule * 2654435761u >> 16) % num_labels;
+        if (noise_dist(rng) < g_bench_config.noise) {
+            tuple[num_attrs] = label_dist(rng);
+        }
+    }
+}
+
+/**
+ * @param[in]   command line arguments as below:
+ *              --rows N          number of training tuples
+ *              --test-rows N     number of test tuples
+ *              --attrs N         number of attributes
+ *              --cardinality N   number of classes of each attribute
+ *              --labels N        number of classes being classified
+ *              --noise P         probability of a random class being classified
+ *              --forest N        train a forest of N trees
+ *              --threads N       number of threads for training the forest
+ *              --seed N          seed of the data and the forest
+ *              --criterion C     split criterion: ratio, gini or chi2
+ * @return      0
+ */
+int main(int argc, const char *argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--rows") == 0) {
+            g_bench_config.num_rows = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--test-rows") == 0) {
+            g_bench_config.num_test_rows = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--attrs") == 0) {
+            g_bench_config.num_attrs = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--cardinality") == 0) {
+            g_bench_config.cardinality = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--labels") == 0) {
+            g_bench_config.num_labels = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--noise") == 0) {
+            g_bench_config.noise = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--forest") == 0) {
+            g_bench_config.num_trees = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            g_bench_config.num_threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            g_bench_config.seed = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--criterion") == 0) {
+            if (strcmp(argv[i + 1], "ratio") == 0) {
+                g_bench_config.criterion = Criterion::GAIN_RATIO;
+            } else if (strcmp(argv[i + 1], "gini") == 0) {
+                g_bench_config.criterion = Criterion::GINI;
+            } else if (strcmp(argv[i + 1], "chi2") == 0) {
+                g_bench_config.criterion = Criterion::CHI_SQUARE;
+            } else {
+                cout << "Unknown criterion " << argv[i + 1] << ". Program terminated." << endl;
+                return 0;
+            }
+        } else {
+            cout << "Unknown option " << argv[i] << ". Program terminated." << endl;
+            return 0;
+        }
+    }
+    if (argc % 2 == 0 || g_bench_config.num_rows <= 0 || g_bench_config.num_attrs <= 0
+            || g_bench_config.cardinality <= 0 || g_bench_config.num_labels <= 0) {
+        cout << "Invalid usage. Please check the arguments." << endl
+           << "$ [executable file] [--rows N] [--test-rows N] [--attrs N] [--cardinality N] "
+           << "[--labels N] [--noise P] [--forest N] [--threads N] [--seed N] "
+           << "[--criterion ratio|gini|chi2]" << endl;
+        return 0;
+    }
+
+    printf("rows,attrs,cardinality,labels,noise,trees,phase,seconds,items,items_per_sec,peak_rss_kb\n");
+
+    // generate the training and test data
+    mt19937 rng(g_bench_config.seed);
+    Dataset training;
+    Dataset test;
+    auto begin = chrono::steady_clock::now();
+    GenerateData(rng, g_bench_config.num_rows, training);
+    GenerateData(rng, g_bench_config.num_test_rows, test);
+    PrintPhase("generate", Elapsed(begin), (long)training.num_rows + test.num_rows);
+
+    // train the model
+    RandomForest forest;
+    long num_nodes = 0;
+    if (g_bench_config.num_trees > 0) {
+        ForestConfig config;
+        config.num_trees = g_bench_config.num_trees;
+        config.num_threads = g_bench_config.num_threads;
+        config.seed = g_bench_config.seed;
+        config.tree.criterion = g_bench_config.criterion;
+
+        // trees are flattened inside the training threads
+        begin = chrono::steady_clock::now();
+        forest.Train(training, config);
+        double seconds = Elapsed(begin);
+        for (auto &tree : forest.trees_) {
+            num_nodes += tree.NumNodes();
+        }
+        PrintPhase("train", seconds, num_nodes);
+    } else {
+        TreeConfig config;
+        config.criterion = g_bench_config.criterion;
+        begin = chrono::steady_clock::now();
+        DecisionTree *tree = new DecisionTree(training, config);
+        double seconds = Elapsed(begin);
+
+        begin = chrono::steady_clock::now();
+        forest.Add(*tree, training);
+        double flatten_seconds = Elapsed(begin);
+        num_nodes = forest.trees_[0].NumNodes();
+        PrintPhase("train", seconds, num_nodes);
+        PrintPhase("flatten", flatten_seconds, num_nodes);
+        delete tree;
+    }
+
+    // classify the test data by batch
+    vector<int> labels(test.num_rows);
+    begin = chrono::steady_clock::now();
+    forest.Classify(test.codes.data(), test.num_rows, test.num_attrs, labels.data());
+    PrintPhase("classify", Elapsed(begin), test.num_rows);
+
+    // keep the result alive so that the classification is not optimized out
+    long correct = 0;
+    for (int row = 0; row < test.num_rows; row++) {
+        correct += labels[row] == test.Code(row, test.LabelIdx());
+    }
+    fprintf(stderr, "accuracy: %.4f\n", test.num_rows > 0 ? (double)correct / test.num_rows : 0.0);
+
+    return 0;
+}
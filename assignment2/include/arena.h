@@ -0,0 +1,117 @@
+/**
+ * Bump(arena) allocator for the tree nodes and the per-node scratch tables
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        arena.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_ARENA_H__
+#define __ASSIGNMENT2_INCLUDE_ARENA_H__
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std;
+
+#define ARENA_BLOCK_SIZE (1 << 20) // default size of a memory block
+
+/**
+ * Memory is handed out from large blocks by bumping an offset and is given back
+ * all at once by resetting to a marker taken before, like a stack.
+ * Blocks are kept after reset, so a warmed up arena does not touch the heap.
+ * Objects are not constructed nor destructed by the arena.
+ */
+class Arena {
+public:
+    struct Marker {
+        size_t block;
+        size_t offset;
+    };
+
+    explicit Arena(size_t block_size = ARENA_BLOCK_SIZE)
+    : block_size_(block_size), block_(0), offset_(0) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * Allocate uninitialized memory for n objects
+     *
+     * @param[in]   n   number of objects
+     * return       address of the first object
+     */
+    template <typename T>
+    T *Alloc(size_t n) {
+        size_t bytes = n * sizeof(T);
+        size_t begin = AlignUp(offset_, alignof(T));
+        if (block_ >= blocks_.size() || begin + bytes > blocks_[block_].size) {
+            NextBlock(bytes + alignof(T));
+            begin = AlignUp(offset_, alignof(T));
+        }
+        offset_ = begin + bytes;
+        return reinterpret_cast<T *>(blocks_[block_].data.get() + begin);
+    }
+
+    /**
+     * Allocate n objects filled with the value
+     */
+    template <typename T>
+    T *Alloc(size_t n, const T &value) {
+        T *ptr = Alloc<T>(n);
+        fill(ptr, ptr + n, value);
+        return ptr;
+    }
+
+    Marker Mark() const {
+        return Marker { block_, offset_ };
+    }
+
+    /**
+     * Give back every memory allocated after the marker
+     */
+    void Reset(const Marker &marker) {
+        block_ = marker.block;
+        offset_ = marker.offset;
+    }
+
+private:
+    struct Block {
+        unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    vector<Block> blocks_; // memory blocks, blocks after block_ are free
+    size_t block_size_; // default size of a block
+    size_t block_; // block being used
+    size_t offset_; // first free byte of the block being used
+
+    static size_t AlignUp(size_t offset, size_t align) {
+        return (offset + align - 1) & ~(align - 1);
+    }
+
+    /**
+     * Move to the next block which has at least the given bytes
+     * A new block is inserted if the next free block is too small
+     */
+    void NextBlock(size_t bytes) {
+        size_t next = blocks_.empty() ? 0 : block_ + 1;
+        if (next >= blocks_.size() || blocks_[next].size < bytes) {
+            size_t size = max(block_size_, bytes);
+            Block block { unique_ptr<char[]>(new char[size]), size };
+            blocks_.insert(blocks_.begin() + next, move(block));
+        }
+        block_ = next;
+        offset_ = 0;
+    }
+};
+
+/**
+ * Scratch arena of the calling thread
+ */
+inline Arena &ThreadArena() {
+    static thread_local Arena arena;
+    return arena;
+}
+
+#endif // __ASSIGNMENT2_INCLUDE_ARENA_H__
@@ -0,0 +1,271 @@
+/**
+ * Split criteria of the decision tree
+ * Each criterion scores the information table(class of A x class being classified)
+ * of a candidate attribute, and is given to the tree as a compile-time policy
+ * so that the loop over the cells of the table is inlined per criterion
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        criterion.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_CRITERION_H__
+#define __ASSIGNMENT2_INCLUDE_CRITERION_H__
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+enum class Criterion {
+    GAIN_RATIO, // information gain normalized by the split information (C4.5)
+    GINI, // decrease of the Gini impurity (CART), no logarithm
+    CHI_SQUARE // chi-square statistic of independence per degree of freedom
+};
+
+#define LOG2_TABLE_SIZE 4096 // n * log2(n) is looked up for n smaller than this
+
+/**
+ * Calculate n * log2(n) with the lookup table for small counts
+ *
+ * @param[in]   n   count
+ * return       n * log2(n), 0 if n is 0
+ */
+inline double NLog2N(int n) {
+    static const vector<double> table = [] {
+        vector<double> t(LOG2_TABLE_SIZE, 0.0);
+        for (int i = 1; i < LOG2_TABLE_SIZE; i++) {
+            t[i] = i * log2((double)i);
+        }
+        return t;
+    }();
+
+    if (n < LOG2_TABLE_SIZE) {
+        return table[n];
+    }
+    return n * log2((double)n);
+}
+
+/**
+ * Calculate the expected information (information entropy)
+ *
+ * Let p(i) be the probability that an arbitrary tuple in D belongs to class C(i),
+ * estimated by |C(i,D)|/|D|
+ *
+ * Expected information(entropy): Info(D) = -Sigma{ p(i) * log(p(i)) / log(2) }
+ *                                        = ( |D|log|D| - Sigma{ |C(i,D)|log|C(i,D)| } ) / |D|
+ * so that only n * log2(n) of integer counts is needed (NLog2N)
+ *
+ * @param[in]   factors    information table with one tuple
+ * @param[in]   size       number of factors
+ * return       information_entropy calculated information entropy
+ */
+inline double InformationEntropy(const int *factors, int size) {
+   int denominator = 0;
+   double sum = 0.0;
+   for (int i = 0; i < size; i++) {
+       denominator += factors[i];
+       sum += NLog2N(factors[i]);
+   }
+
+   if (denominator == 0) {
+       return 0.0;
+   }
+   return (NLog2N(denominator) - sum) / denominator;
+}
+
+/**
+ * Calculate the expected information (information entropy)
+ *
+ * Expected information(entropy):
+ * Info(D) with A attribute = Sigma{ |D(i)|/|D| * Info(D(i)) }
+ *                          = Sigma{ |D(i)|log|D(i)| - Sigma{ |C(j,D(i))|log|C(j,D(i))| } } / |D|
+ *
+ * @param[in]   table         information table(class of A x class being classified) in row-major
+ * @param[in]   num_values    number of classes of A(rows of the table)
+ * @param[in]   num_labels    number of classes being classified(columns of the table)
+ * return       information_entropy calculated information entropy
+ */
+inline double InformationEntropy(const int *table, int num_values, int num_labels) {
+   int denominator = 0;
+   double sum = 0.0;
+   for (int i = 0; i < num_values; i++, table += num_labels) {
+       int size = 0;
+       for (int j = 0; j < num_labels; j++) {
+           size += table[j];
+           sum -= NLog2N(table[j]);
+       }
+       sum += NLog2N(size);
+       denominator += size;
+   }
+
+   if (denominator == 0) {
+       return 0.0;
+   }
+   return sum / denominator;
+}
+
+/**
+ * Calculate the split information
+ *
+ * Split information(entropy):
+ * SplitInfo(D) with A attribute = - Sigma{ |D(i)|/|D| * log(|D(i)|/|D|) / log(2) }
+ *                               = ( |D|log|D| - Sigma{ |D(i)|log|D(i)| } ) / |D|
+ *
+ * @param[in]   table         information table(class of A x class being classified) in row-major
+ * @param[in]   num_values    number of classes of A(rows of the table)
+ * @param[in]   num_labels    number of classes being classified(columns of the table)
+ * return       split_info calculated split information
+ */
+inline double SplitInformation(const int *table, int num_values, int num_labels) {
+   int denominator = 0;
+   double sum = 0.0;
+   for (int i = 0; i < num_values; i++, table += num_labels) {
+       int size = 0;
+       for (int j = 0; j < num_labels; j++) {
+           size += table[j];
+       }
+       sum += NLog2N(size);
+       denominator += size;
+   }
+
+   if (denominator == 0) {
+       return 0.0;
+   }
+   return (NLog2N(denominator) - sum) / denominator;
+}
+
+/**
+ * Class counts of the node being split, shared by the scores of every candidate
+ */
+struct NodeStats {
+    const int *label_cnt; // weighted number of tuples of each class being classified
+    const double *label_weight; // 1 / label_cnt of each class, 0 if the class is empty
+    int num_labels; // number of classes being classified
+    int num_present; // number of classes with at least one tuple
+    int total; // weighted number of tuples
+    double entropy; // information entropy of the node
+};
+
+/**
+ * Score of a candidate split, the larger the better
+ * gain is compared with the minimum gain of a split
+ */
+struct SplitScore {
+    double score;
+    double gain;
+};
+
+/**
+ * Sum of the weighted squares of each row of the table
+ *   sums[i] = Sigma{ table[i][j]^2 * weight[j] } (or without the weight)
+ *   sizes[i] = Sigma{ table[i][j] }
+ * The loop over the cells of a row is vectorized(SIMD), the counts are converted to
+ * doubles so that the squares do not overflow
+ *
+ * @param[in]   row           row of the information table
+ * @param[in]   num_labels    number of cells of the row
+ * @param[in]   weight        weight of each column, nullptr means 1
+ * @param[out]  size          sum of the cells
+ * return       sum of the weighted squares of the cells
+ */
+inline double SumOfSquares(const int *row, int num_labels, const double *weight, int &size) {
+    int sum = 0;
+    double squares = 0.0;
+    if (weight == nullptr) {
+        #pragma omp simd reduction(+:sum, squares)
+        for (int j = 0; j < num_labels; j++) {
+            double cell = row[j];
+            sum += row[j];
+            squares += cell * cell;
+        }
+    } else {
+        #pragma omp simd reduction(+:sum, squares)
+        for (int j = 0; j < num_labels; j++) {
+            double cell = row[j];
+            sum += row[j];
+            squares += cell * cell * weight[j];
+        }
+    }
+    size = sum;
+    return squares;
+}
+
+/**
+ * Information gain ratio (C4.5)
+ *   GainRatio(A) = ( Info(D) - Info(D) with A ) / SplitInfo(D) with A
+ * The gain is the information gain
+ */
+struct GainRatioCriterion {
+    static SplitScore Score(const int *table, int num_values, const NodeStats &node) {
+        // get information gain which is an index of getting information
+        double gain = node.entropy - InformationEntropy(table, num_values, node.num_labels);
+        // get split information for revising the distortion from info gain
+        double split_info = SplitInformation(table, num_values, node.num_labels);
+        // get information ratio from info gain and split info
+        // (all tuples have the same class of the attribute if split info is 0)
+        double ratio = split_info > 0 ? max(gain / split_info, 0.0) : 0.0;
+        return SplitScore { ratio, gain };
+    }
+};
+
+/**
+ * Decrease of the Gini impurity (CART)
+ *   Gini(D) = 1 - Sigma{ p(i)^2 } = 1 - Sigma{ |C(i,D)|^2 } / |D|^2
+ *   Gini(D) with A = Sigma{ |D(i)|/|D| * Gini(D(i)) }
+ *                  = 1 - Sigma{ Sigma{ |C(j,D(i))|^2 } / |D(i)| } / |D|
+ * The gain is the decrease of the impurity, the same as the score
+ */
+struct GiniCriterion {
+    static SplitScore Score(const int *table, int num_values, const NodeStats &node) {
+        if (node.total == 0) {
+            return SplitScore { 0.0, 0.0 };
+        }
+
+        int size;
+        double before = SumOfSquares(node.label_cnt, node.num_labels, nullptr, size)
+            / ((double)node.total * node.total);
+        double after = 0.0;
+        for (int i = 0; i < num_values; i++, table += node.num_labels) {
+            double squares = SumOfSquares(table, node.num_labels, nullptr, size);
+            if (size > 0) {
+                after += squares / size;
+            }
+        }
+        after /= node.total;
+
+        // 1 - before_squares subtracted from 1 - after_squares
+        double gain = max(after - before, 0.0);
+        return SplitScore { gain, gain };
+    }
+};
+
+/**
+ * Chi-square statistic of the independence of A and the class being classified
+ *   Chi2 = Sigma{ (O(i,j) - E(i,j))^2 / E(i,j) }, E(i,j) = |D(i)| * |C(j,D)| / |D|
+ *        = |D| * ( Sigma{ Sigma{ |C(j,D(i))|^2 / |C(j,D)| } / |D(i)| } - 1 )
+ * divided by the degrees of freedom (r - 1)(c - 1) of the non-empty rows and columns,
+ * so that the attributes with many classes are not preferred
+ * The gain is the same as the score
+ */
+struct ChiSquareCriterion {
+    static SplitScore Score(const int *table, int num_values, const NodeStats &node) {
+        int num_rows = 0;
+        double sum = 0.0;
+        for (int i = 0; i < num_values; i++, table += node.num_labels) {
+            int size;
+            double squares = SumOfSquares(table, node.num_labels, node.label_weight, size);
+            if (size > 0) {
+                sum += squares / size;
+                num_rows++;
+            }
+        }
+
+        int dof = (num_rows - 1) * (node.num_present - 1);
+        if (dof <= 0) {
+            return SplitScore { 0.0, 0.0 };
+        }
+        double chi_square = max(node.total * (sum - 1.0), 0.0);
+        return SplitScore { chi_square / dof, chi_square / dof };
+    }
+};
+
+#endif // __ASSIGNMENT2_INCLUDE_CRITERION_H__
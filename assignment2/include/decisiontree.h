@@ -12,254 +12,470 @@
 #include <string>
 #include <set>
 #include <cmath>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include "arena.h"
+#include "criterion.h"
 
 using namespace std;
 
 typedef string class_t;
 typedef vector<string> tuple_t;
 
+/**
+ * Training data encoded once into class indices
+ * Every tree node(and every tree of a forest) refers to the tuples by row index
+ * instead of copying them
+ */
+struct Dataset {
+    tuple_t attributes; // all attributes, the last one is the attribute being classified
+    vector<vector<class_t>> class_of_attr; // sorted classes of each attribute
+    vector<int> codes; // row-major tuples, each value is an index into class_of_attr
+    int num_rows = 0;
+    int num_attrs = 0;
+
+    int Code(int row, int attr) const {
+        return codes[(size_t)row * num_attrs + attr];
+    }
+
+    int LabelIdx() const {
+        return num_attrs - 1;
+    }
+
+    /**
+     * Translate the class of an attribute into its index
+     *
+     * @param[in]   attr    attribute index
+     * @param[in]   cls     class of the attribute
+     * return       index of the class, -1 if it never appeared in the training data
+     */
+    int Encode(int attr, const class_t &cls) const {
+        const vector<class_t> &classes = class_of_attr[attr];
+        auto it = lower_bound(classes.begin(), classes.end(), cls);
+        if (it == classes.end() || *it != cls) {
+            return -1;
+        }
+        return it - classes.begin();
+    }
+
+    /**
+     * Translate the class of an attribute into its index without copying the string
+     *
+     * @param[in]   attr    attribute index
+     * @param[in]   str     class of the attribute (not null terminated)
+     * @param[in]   len     length of the class
+     * return       index of the class, -1 if it never appeared in the training data
+     */
+    int Encode(int attr, const char *str, size_t len) const {
+        const vector<class_t> &classes = class_of_attr[attr];
+        int low = 0;
+        int high = classes.size() - 1;
+        while (low <= high) {
+            int mid = (low + high) / 2;
+            int cmp = classes[mid].compare(0, string::npos, str, len);
+            if (cmp == 0) {
+                return mid;
+            } else if (cmp < 0) {
+                low = mid + 1;
+            } else {
+                high = mid - 1;
+            }
+        }
+        return -1;
+    }
+};
+
+/**
+ * Options for growing a tree
+ */
+struct TreeConfig {
+    int max_features = 0; // number of random candidate attributes per node, 0 means all
+    int max_depth = 0; // maximum depth of the tree(the root is 0), 0 means unlimited
+    int min_samples_leaf = 1; // minimum weighted number of tuples of every child
+    double min_gain = 0.0; // minimum gain of a split (information gain, Gini decrease or chi-square)
+    Criterion criterion = Criterion::GAIN_RATIO; // measure for selecting the splitting attribute
+};
+
 class DecisionTree {
 public:
-    string attribute_; // the classifier index of the tree node
-    vector<class_t> classes_; // children classes of the tree node
-    vector<DecisionTree> branches_; // children classes' node
+    string attribute_; // the classifier of the tree node, or the decided class of the leaf
+    int attr_idx_; // index of the classifier attribute, -1 if the node is leaf
+    int label_idx_; // index of the majority class of the tuples reaching the node
+    int *class_idx_; // index of each children class
+    DecisionTree *branches_; // children classes' node
+    int num_branches_; // number of children
+    int default_branch_; // child with the most training tuples, for the class unseen or missing
     bool is_leaf_; // if the node is leaf, it means the classification process has been done
-
-    vector<tuple_t> training_data_; // training data for select the attribute
-    tuple_t attributes_; // attributes of training data
-    vector<vector<class_t>> class_of_attr_; // classes of each attribute
+    int depth_; // depth of the node, the root is 0
+
+    const Dataset *data_; // training data shared by every node
+    const TreeConfig *config_; // options for growing the tree
+    const vector<int> *weights_; // weight(bootstrap count) of each row, nullptr means 1
+    mt19937 *rng_; // random source for the candidate attribute subset
+    unique_ptr<Arena> own_pool_; // node pool owned by the root
+    Arena *pool_; // node pool of the tree: nodes and their children classes
+    Arena *scratch_; // scratch of the training thread, reset after each node
+    const int *table_offset_; // offset of the information table of each attribute
+
+    // training state in the scratch, only valid while the node is being built
+    int *rows_; // rows of training data reaching the node
+    int num_rows_;
+    const int *attrs_; // candidate attributes which are not split yet
+    int num_attrs_;
+    const int *label_cnt_; // weighted number of tuples of each class being classified
+    int *info_tables_; // information tables of every attribute, nullptr if not counted yet
+    bool *counted_; // whether the information table of each attribute is counted
     double info_entropy_before_; // Expected information(information entropy) before split
 
     /**
      * Generate DecisionTree recursively with greedy manner
-     *  - Use information ratio for selecting attribute
+     *  - Use the split criterion(information ratio by default) for selecting attribute
      *  - Check the stop splitting condition
+     * Nodes are allocated from the node pool of the root, and the training data of
+     * each node lives in the scratch arena of the thread
      *
-     * @param[in]   training_data    tuple data for training the model at each level
-     * @param[in]   attributes       attributes for training the model at each level
-     * @param[in]   class_of_attr    sub classes of each attribute 
+     * @param[in]   data        training data shared by every node
+     * @param[in]   config      options for growing the tree
+     * @param[in]   weights     weight of each row (e.g. bootstrap sample), nullptr means 1
+     * @param[in]   rng         random source used when config.max_features is set
      */
-    DecisionTree(vector<tuple_t> &training_data, tuple_t &attributes, vector<vector<class_t>> &class_of_attr)
-    : is_leaf_(false), training_data_(training_data), attributes_(attributes), class_of_attr_(class_of_attr) {
+    DecisionTree(const Dataset &data, const TreeConfig &config,
+            const vector<int> *weights = nullptr, mt19937 *rng = nullptr)
+    : attr_idx_(-1), label_idx_(0), class_idx_(nullptr), branches_(nullptr), num_branches_(0),
+      default_branch_(0), is_leaf_(false), depth_(0), data_(&data), config_(&config),
+      weights_(weights), rng_(rng), own_pool_(new Arena()), pool_(own_pool_.get()), scratch_(&ThreadArena()),
+      label_cnt_(nullptr), info_tables_(nullptr), counted_(nullptr) {
+
+        Arena::Marker marker = scratch_->Mark();
+
+        int num_labels = NumLabels();
+        int *table_offset = pool_->Alloc<int>(data.num_attrs + 1);
+        table_offset[0] = 0;
+        for (int attr = 0; attr < data.num_attrs; attr++) {
+            table_offset[attr + 1] = table_offset[attr] + data.class_of_attr[attr].size() * num_labels;
+        }
+        table_offset_ = table_offset;
 
-        GetInfoEntropyBeforeSplit();
-        if(ContinueSplit()) {
-            vector<double> info_ratio;
-            UseInformationRatio(info_ratio);
-            SelectAttribute(info_ratio);
-            BuildSubTree();
+        rows_ = scratch_->Alloc<int>(data.num_rows);
+        num_rows_ = 0;
+        for (int row = 0; row < data.num_rows; row++) {
+            if (weights == nullptr || (*weights)[row] > 0) {
+                rows_[num_rows_++] = row;
+            }
         }
+        int *attrs = scratch_->Alloc<int>(data.LabelIdx());
+        for (int attr = 0; attr < data.LabelIdx(); attr++) {
+            attrs[attr] = attr;
+        }
+        attrs_ = attrs;
+        num_attrs_ = data.LabelIdx();
+        Build();
+
+        scratch_->Reset(marker);
     }
 
     /**
-     * Calculate the expected information (information entropy)
+     * Generate child node of the parent with the filtered rows
+     * The class counts(and the information tables if the parent derived them)
+     * are inherited from the parent instead of counting them again
      *
-     * Let p(i) be the probability that an arbitrary tuple in D belongs to class C(i),
-     * estimated by |C(i,D)|/|D|
-     *
-     * Expected information(entropy): Info(D) = -Sigma{ p(i) * log(p(i)) / log(2) }
-     *  
-     * @param[in]   factors    information table with one tuple
-     * return       information_entropy calculated information entropy
+     * @param[in]   parent          parent node
+     * @param[in]   rows            rows of training data belonging to the branch
+     * @param[in]   num_rows        number of rows
+     * @param[in]   attrs           candidate attributes not split yet
+     * @param[in]   num_attrs       number of candidate attributes
+     * @param[in]   label_cnt       class counts of the branch
+     * @param[in]   info_tables     information tables of the branch, nullptr if not derived
+     * @param[in]   counted         whether each information table is derived
+     */
+    DecisionTree(const DecisionTree &parent, int *rows, int num_rows, const int *attrs,
+            int num_attrs, const int *label_cnt, int *info_tables, bool *counted)
+    : attr_idx_(-1), label_idx_(0), class_idx_(nullptr), branches_(nullptr), num_branches_(0),
+      default_branch_(0), is_leaf_(false), depth_(parent.depth_ + 1), data_(parent.data_),
+      config_(parent.config_), weights_(parent.weights_), rng_(parent.rng_), pool_(parent.pool_),
+      scratch_(parent.scratch_), table_offset_(parent.table_offset_), rows_(rows),
+      num_rows_(num_rows), attrs_(attrs), num_attrs_(num_attrs), label_cnt_(label_cnt),
+      info_tables_(info_tables), counted_(counted) {
+        Build();
+    }
+
+    DecisionTree(const DecisionTree &) = delete;
+    DecisionTree &operator=(const DecisionTree &) = delete;
+
+    ~DecisionTree() {
+        for (int i = 0; i < num_branches_; i++) {
+            branches_[i].~DecisionTree();
+        }
+    }
+
+    /**
+     * Split the node
+     * The training data of the node is forgotten, the scratch is given back by the caller
      */
-    double GetInformationEntropy(vector<int> &factors) {
-       double denominator = 0.0;
-       for (auto factor : factors) {
-           denominator += factor;
-       }
-
-       double info_entropy = 0.0; 
-       double probability = 0.0;
-       for (auto factor : factors) {
-           if (factor != 0) {
-               probability = (double)factor / denominator;
-               info_entropy -= probability * log(probability) / log(2);
-           }
-       }
-
-       return info_entropy;
+    void Build() {
+        GetInfoEntropyBeforeSplit();
+        if (ContinueSplit()) {
+            int *candidates;
+            int num_candidates;
+            double *score;
+            double *gain;
+            // the criterion is decided once per node, the scoring loop is specialized for it
+            if (config_->criterion == Criterion::GINI) {
+                ScoreCandidates<GiniCriterion>(candidates, num_candidates, score, gain);
+            } else if (config_->criterion == Criterion::CHI_SQUARE) {
+                ScoreCandidates<ChiSquareCriterion>(candidates, num_candidates, score, gain);
+            } else {
+                ScoreCandidates<GainRatioCriterion>(candidates, num_candidates, score, gain);
+            }
+            if (SelectAttribute(candidates, num_candidates, score, gain)) {
+                BuildSubTree();
+            } else {
+                is_leaf_ = true;
+            }
+        }
+
+        // training data is not valid after the node has been built
+        rows_ = nullptr;
+        attrs_ = nullptr;
+        label_cnt_ = nullptr;
+        info_tables_ = nullptr;
+        counted_ = nullptr;
     }
 
     /**
-     * Calculate the expected information (information entropy)
-     *
-     * Expected information(entropy):
-     * Info(D) with A attribute = Sigma{ |D(i)|/|D| * Info(D(i)) }
-     *  
-     * @param[in]   table    information table with multiple tuple(class)
-     * return       information_entropy calculated information entropy
+     * Weight of the row, 1 if the tree is trained with the whole training data
      */
-    double GetInformationEntropy(vector<vector<int>> &table) {
-       double denominator = 0.0;
-       for (auto factors : table) {
-           for (auto factor : factors) {
-               denominator += factor;
-           }
-       }
-
-       double info_entropy = 0.0; 
-       double probability = 0.0;
-       for (auto factors : table) {
-           probability = 0.0;
-           for (auto factor : factors) {
-               probability += factor; 
-           }
-           probability /= denominator;
-           info_entropy += probability * GetInformationEntropy(factors);
-       }
-
-       return info_entropy;
+    int Weight(int row) {
+        return weights_ == nullptr ? 1 : (*weights_)[row];
+    }
+
+    int NumLabels() {
+        return data_->class_of_attr[data_->LabelIdx()].size();
+    }
+
+    int NumClasses(int attr) {
+        return data_->class_of_attr[attr].size();
+    }
+
+    /**
+     * Weighted number of tuples with the class counts
+     */
+    int TotalWeight(const int *label_cnt) {
+        int total = 0;
+        int num_labels = NumLabels();
+        for (int i = 0; i < num_labels; i++) {
+            total += label_cnt[i];
+        }
+        return total;
     }
 
     /**
      * Calculate the information entropy before split the decision branches
      * Get expected information(entropy) by counting the classes of
      * attribute now being classified
+     * Children already inherited the counts from the parent's information table
      */
     void GetInfoEntropyBeforeSplit() {
-        int finding_attr_idx = class_of_attr_.size() - 1;
-
-        vector<int> info_table;
-        info_table.assign(class_of_attr_[finding_attr_idx].size(), 0);
+        int finding_attr_idx = data_->LabelIdx();
+        int num_labels = NumLabels();
 
-        for (auto tuple : training_data_) {
-            int idx = 0;
-            for (auto cls : class_of_attr_[finding_attr_idx]) {
-                if (cls == tuple[finding_attr_idx]) {
-                   info_table[idx]++; 
-                } else {
-                    idx++;
-                }
+        if (label_cnt_ == nullptr) {
+            int *label_cnt = scratch_->Alloc<int>(num_labels, 0);
+            for (int i = 0; i < num_rows_; i++) {
+                label_cnt[data_->Code(rows_[i], finding_attr_idx)] += Weight(rows_[i]);
             }
+            label_cnt_ = label_cnt;
         }
-       info_entropy_before_ = GetInformationEntropy(info_table);
+        info_entropy_before_ = InformationEntropy(label_cnt_, num_labels);
     }
 
     /**
-     * Calculate the information ratio of each candidate attribute 
+     * Whether every not split attribute is a candidate of the node
+     * (not a random subset of them)
      *
-     * @param[out]   info_ratio    information ratio list of candidate attributes
+     * @param[in]   num_attrs   number of attributes not split yet
      */
-    void UseInformationRatio(vector<double> &info_ratio) {
-        int finding_attr_idx = class_of_attr_.size() - 1;
-        int compared_class_idx;
-        int comparing_class_idx;
-        for (int i = 0; i < finding_attr_idx; i++) {
-            vector<vector<int>> info_table;
-            double gain = 0.0;
-            double ratio = 0.0;
-            double split_info = 0.0;
-
-            info_table.assign(class_of_attr_[i].size(), vector<int>());
-            for (auto &tuple : info_table) {
-                tuple.assign(class_of_attr_[finding_attr_idx].size(), 0);
-            }
+    bool UseAllAttributes(int num_attrs) {
+        int num_features = config_->max_features;
+        return rng_ == nullptr || num_features <= 0 || num_features >= num_attrs;
+    }
 
-            for (auto tuple : training_data_) {
-                compared_class_idx = 0;
-                for (auto cls : class_of_attr_[i]) {
-                   if (cls == tuple[i]) {
-                      break; 
-                   } else {
-                       compared_class_idx++;
-                   }
-                }
+    /**
+     * Pick the candidate attributes of the node
+     * If max_features is set, choose that many attributes randomly (random forest)
+     *
+     * @param[out]   candidates         candidate attributes of the node
+     * @param[out]   num_candidates     number of candidate attributes
+     */
+    void SelectCandidates(int *&candidates, int &num_candidates) {
+        candidates = scratch_->Alloc<int>(num_attrs_);
+        copy(attrs_, attrs_ + num_attrs_, candidates);
+        num_candidates = num_attrs_;
+        int num_features = config_->max_features;
+        if (UseAllAttributes(num_attrs_)) {
+            return;
+        }
 
-                comparing_class_idx = 0;
-                for (auto cls : class_of_attr_[finding_attr_idx]) {
-                   if (cls == tuple[finding_attr_idx]) {
-                      break; 
-                   } else {
-                       comparing_class_idx++;
-                   }
-                }
-                info_table[compared_class_idx][comparing_class_idx]++;
-            }
+        // partial Fisher-Yates shuffle for picking num_features attributes
+        for (int i = 0; i < num_features; i++) {
+            uniform_int_distribution<int> dist(i, num_attrs_ - 1);
+            swap(candidates[i], candidates[dist(*rng_)]);
+        }
+        num_candidates = num_features;
+    }
 
-            // get information gain which is an index of getting information
-            gain = info_entropy_before_ - GetInformationEntropy(info_table);
-            // get split information for revising the distortion from info gain
-            split_info = GetSplitInformation(info_table);
-            // get information ratio from info gain and split info
-            ratio = gain / split_info;
-            info_ratio.push_back(ratio);
+    /**
+     * Count the information table of the attribute
+     * table[class of attr][class being classified] = weighted number of tuples
+     *
+     * @param[in]    rows       rows of training data
+     * @param[in]    num_rows   number of rows
+     * @param[in]    attr       attribute to count
+     * @param[out]   table      information table in row-major
+     */
+    void CountInfoTable(const int *rows, int num_rows, int attr, int *table) {
+        int finding_attr_idx = data_->LabelIdx();
+        int num_labels = NumLabels();
+
+        fill(table, table + NumClasses(attr) * num_labels, 0);
+        for (int i = 0; i < num_rows; i++) {
+            int row = rows[i];
+            table[data_->Code(row, attr) * num_labels + data_->Code(row, finding_attr_idx)]
+                += Weight(row);
         }
+    }
 
+    /**
+     * Whether every branch of the information table has at least min_samples_leaf tuples
+     *
+     * @param[in]   table         information table in row-major
+     * @param[in]   num_values    number of classes of the attribute(rows of the table)
+     * @param[in]   num_labels    number of classes being classified(columns of the table)
+     */
+    bool IsSplitAllowed(const int *table, int num_values, int num_labels) {
+        if (config_->min_samples_leaf <= 1) {
+            return true;
+        }
+        for (int i = 0; i < num_values; i++) {
+            int size = TotalWeight(table + i * num_labels);
+            if (size > 0 && size < config_->min_samples_leaf) {
+                return false;
+            }
+        }
+        return true;
     }
 
     /**
-     * Calculate the split information
+     * Score each candidate attribute with the split criterion
+     * The information table inherited from the parent is used if it exists
+     * The attribute leaving a branch smaller than min_samples_leaf gets score -1
      *
-     * Split information(entropy):
-     * SplitInfo(D) with A attribute = - Sigma{ |D(i)|/|D| * log(|D(i)|/|D|) / log(2) }
-     *  
-     * @param[in]   table    information table with multiple tuple(class)
-     * return       split_info calculated split information 
+     * @tparam       SplitCriterion     GainRatioCriterion, GiniCriterion or ChiSquareCriterion
+     * @param[out]   candidates         candidate attributes of the node
+     * @param[out]   num_candidates     number of candidate attributes
+     * @param[out]   score              score list of candidate attributes
+     * @param[out]   gain               gain list of candidate attributes
      */
-    double GetSplitInformation(vector<vector<int>> &table) {
-       double denominator = 0.0;
-       for (auto factors : table) {
-           for (auto factor : factors) {
-               denominator += factor;
-           }
-       }
-
-       double split_info = 0.0; 
-       double probability = 0.0;
-       for (auto factors : table) {
-           probability = 0.0;
-           for (auto factor : factors) {
-               probability += factor; 
-           }
-           if(probability != 0) {
-               probability /= denominator;
-               split_info -= probability * log(probability) / log(2);
-           }
-       }
-
-       return split_info;
+    template <typename SplitCriterion>
+    void ScoreCandidates(int *&candidates, int &num_candidates, double *&score, double *&gain) {
+        int num_labels = NumLabels();
+
+        SelectCandidates(candidates, num_candidates);
+        score = scratch_->Alloc<double>(num_candidates);
+        gain = scratch_->Alloc<double>(num_candidates);
+        if (info_tables_ == nullptr) {
+            info_tables_ = scratch_->Alloc<int>(table_offset_[data_->num_attrs]);
+            counted_ = scratch_->Alloc<bool>(data_->num_attrs, false);
+        }
+
+        NodeStats node;
+        double *label_weight = scratch_->Alloc<double>(num_labels);
+        node.label_cnt = label_cnt_;
+        node.label_weight = label_weight;
+        node.num_labels = num_labels;
+        node.num_present = 0;
+        node.total = TotalWeight(label_cnt_);
+        node.entropy = info_entropy_before_;
+        for (int i = 0; i < num_labels; i++) {
+            label_weight[i] = label_cnt_[i] > 0 ? 1.0 / label_cnt_[i] : 0.0;
+            node.num_present += label_cnt_[i] > 0;
+        }
+
+        for (int i = 0; i < num_candidates; i++) {
+            int attr = candidates[i];
+            int *info_table = info_tables_ + table_offset_[attr];
+            int num_values = NumClasses(attr);
+
+            if (counted_[attr] == false) {
+                CountInfoTable(rows_, num_rows_, attr, info_table);
+                counted_[attr] = true;
+            }
+
+            SplitScore split = SplitCriterion::Score(info_table, num_values, node);
+            score[i] = split.score;
+            gain[i] = split.gain;
+            if (IsSplitAllowed(info_table, num_values, num_labels) == false) {
+                score[i] = -1.0;
+            }
+        }
     }
 
     /**
-     * Select the spliiting attribute by comparing the info ratio of each candidate
-     * Select the maximum information ratio from the cadidate attributes
+     * Select the spliiting attribute by comparing the score of each candidate
+     * Select the maximum score from the cadidate attributes
      *
-     * @param[in]   info_ratio    information ratio list of candidate attributes
+     * @param[in]   candidates        candidate attributes of the node
+     * @param[in]   num_candidates    number of candidate attributes
+     * @param[in]   score             score list of candidate attributes
+     * @param[in]   gain              gain list of candidate attributes
+     * return       true/false        split(positive) / no attribute is worth to split(negative)
      */
-    void SelectAttribute(vector<double> &info_ratio) {
+    bool SelectAttribute(int *candidates, int num_candidates, double *score, double *gain) {
         double max = 0.0;
-        int max_idx = 0;
-        
-        for (unsigned int i = 0; i < info_ratio.size(); i++) {
-            if (info_ratio[i] > max) {
-               max = info_ratio[i];
-               max_idx = i; 
+        int max_idx = -1;
+
+        for (int i = 0; i < num_candidates; i++) {
+            if (score[i] >= 0 && (max_idx < 0 || score[i] > max)) {
+               max = score[i];
+               max_idx = i;
             }
         }
 
-        attribute_ = attributes_[max_idx];
-        classes_ = class_of_attr_[max_idx];
+        // [stop] every split leaves a too small branch or gains too little
+        if (max_idx < 0 || gain[max_idx] < config_->min_gain) {
+            return false;
+        }
+
+        attr_idx_ = candidates[max_idx];
+        attribute_ = data_->attributes[attr_idx_];
+        return true;
     }
 
     /**
      * Decide whether continue spliiting or stop
-     * 3 criteria for stop spliiting:
+     * 5 criteria for stop spliiting:
      *  - no more attribute to split -> majority voting
      *  - all samples for a given node belong to the one same class (decision made)
-     *  - no sample left 
+     *  - no sample left
+     *  - the node is at the maximum depth
+     *  - too few samples to make two children of min_samples_leaf
      *
      * return       true/false    continue to split(positive) / stop to split(negative)
      */
     bool ContinueSplit() {
-        int finding_attr_idx = class_of_attr_.size() - 1;
+        MajorityVote();
         // [stop] no more attribute to being split criteria
-        if (class_of_attr_.size() < 2) {
-            MajorityVote();
+        if (num_attrs_ == 0 || num_rows_ == 0) {
             is_leaf_ = true;
             return false;
         // [stop] already splitted to one side which means info entropy = 0
         } else if (info_entropy_before_ == 0) {
-            attribute_ = training_data_[0][finding_attr_idx];
+            is_leaf_ = true;
+            return false;
+        // [stop] early stopping for bounding the size of the tree
+        } else if (IsEarlyStop(depth_, TotalWeight(label_cnt_))) {
             is_leaf_ = true;
             return false;
         } else {
@@ -267,86 +483,185 @@ public:
         }
     }
 
+    /**
+     * Whether the node should not split by the maximum depth or the minimum leaf size
+     *
+     * @param[in]   depth       depth of the node
+     * @param[in]   weight      weighted number of tuples of the node
+     */
+    bool IsEarlyStop(int depth, int weight) {
+        return (config_->max_depth > 0 && depth >= config_->max_depth)
+            || weight < 2 * config_->min_samples_leaf;
+    }
+
     /**
      * Make the decision with majority vote by counting the tuple
      * Select the attribute with max vote
      */
     void MajorityVote() {
-        int finding_attr_idx = class_of_attr_.size() - 1;
-        vector<int> cnt(class_of_attr_[finding_attr_idx].size());
+        int finding_attr_idx = data_->LabelIdx();
+        int num_labels = NumLabels();
 
         int idx = 0;
-        for (auto tuple : training_data_) {
-            idx = 0;
-            if (tuple[finding_attr_idx] == class_of_attr_[finding_attr_idx][idx] ) {
-                cnt[idx]++;
-            } else {
-                idx++;
-            }
-        }
-
-        idx = 0;
         int max = 0;
-        for (unsigned int i = 0; i < cnt.size(); i++) {
-            if (cnt[i] > max) {
-               max = cnt[i];
+        for (int i = 0; i < num_labels; i++) {
+            if (label_cnt_[i] > max) {
+               max = label_cnt_[i];
                idx = i;
             }
         }
 
-        attribute_ = class_of_attr_[finding_attr_idx][idx];
+        label_idx_ = idx;
+        attribute_ = data_->class_of_attr[finding_attr_idx][idx];
+    }
+
+    /**
+     * Whether the child would split again with its class counts
+     *
+     * @param[in]   label_cnt   class counts of the child
+     * @param[in]   num_attrs   number of attributes left to the child
+     */
+    bool ChildMaySplit(const int *label_cnt, int num_attrs) {
+        int num_labels = NumLabels();
+        int num_classes = 0;
+        for (int i = 0; i < num_labels; i++) {
+            if (label_cnt[i] > 0) {
+                num_classes++;
+            }
+        }
+        return num_attrs > 0 && num_classes > 1
+            && IsEarlyStop(depth_ + 1, TotalWeight(label_cnt)) == false;
     }
 
     /**
      * Build subtree w.r.t already selected attribute
-     * each child node would inherit the filtered training data by its branch class
+     * each child node would inherit the filtered rows by its branch class
+     *
+     * The rows are partitioned in place by the class of the selected attribute, so each
+     * child gets a contiguous range of the parent's rows.
+     * The class counts of each child are the rows of the information table of the
+     * selected attribute. If every attribute is a candidate, the information tables
+     * of the largest child are derived by subtracting the other children's tables
+     * from this node's tables (histogram subtraction), so only the smaller children
+     * are counted.
      */
     void BuildSubTree() {
-        int split_attr_idx = 0;
-        for (auto attr : attributes_) {
-            if (attribute_ == attr) {
-               break; 
-            } else {
-                split_attr_idx++;
+        int num_labels = NumLabels();
+        int num_values = NumClasses(attr_idx_);
+        int num_table = table_offset_[data_->num_attrs];
+
+        // partition the rows by the class of the selected attribute (counting sort)
+        int *begin = scratch_->Alloc<int>(num_values + 1, 0);
+        for (int i = 0; i < num_rows_; i++) {
+            begin[data_->Code(rows_[i], attr_idx_) + 1]++;
+        }
+        for (int i = 0; i < num_values; i++) {
+            begin[i + 1] += begin[i];
+        }
+        {
+            Arena::Marker marker = scratch_->Mark();
+            int *sorted = scratch_->Alloc<int>(num_rows_);
+            int *next = scratch_->Alloc<int>(num_values);
+            copy(begin, begin + num_values, next);
+            for (int i = 0; i < num_rows_; i++) {
+                sorted[next[data_->Code(rows_[i], attr_idx_)]++] = rows_[i];
             }
+            copy(sorted, sorted + num_rows_, rows_);
+            scratch_->Reset(marker);
         }
 
-        int split_class_idx = 0;
-        vector<vector<tuple_t>> training_data_per_class;
-        training_data_per_class.assign(classes_.size(), vector<tuple_t> ());
-        for (auto tuple : training_data_) {
-            split_class_idx = 0;
-            for (auto cls : classes_) {
-                if (cls == tuple[split_attr_idx]) {
-                    training_data_per_class[split_class_idx].push_back(tuple);
-                } else {
-                    split_class_idx++;
-                }
+        int *attrs = scratch_->Alloc<int>(num_attrs_);
+        int num_attrs = 0;
+        for (int i = 0; i < num_attrs_; i++) {
+            if (attrs_[i] != attr_idx_) {
+                attrs[num_attrs++] = attrs_[i];
             }
         }
 
-        attributes_.erase(attributes_.begin() + split_attr_idx);
-        class_of_attr_.erase(class_of_attr_.begin() + split_attr_idx);
-        for (auto &training_data : training_data_per_class) {
-            for (auto &tuple : training_data) {
-                tuple.erase(tuple.begin() + split_attr_idx);
+        // if there is no data for training, no branch(node)
+        for (int i = 0; i < num_values; i++) {
+            if (begin[i + 1] > begin[i]) {
+                num_branches_++;
+            }
+        }
+        class_idx_ = pool_->Alloc<int>(num_branches_);
+        for (int i = 0, j = 0; i < num_values; i++) {
+            if (begin[i + 1] > begin[i]) {
+                class_idx_[j++] = i;
             }
         }
 
-        int size = classes_.size();
-        vector<int> cls_idx;
-        for (int i = 0; i < size; i++) {
-            // if there is no data for training, no branch(node)
-            if (training_data_per_class[i].size() == 0) {
-                classes_.erase(classes_.begin() + i);
-            } else {
-                cls_idx.push_back(i);
+        // class counts of each child from the information table of the selected attribute
+        const int *split_table = info_tables_ + table_offset_[attr_idx_];
+        bool *may_split = scratch_->Alloc<bool>(num_branches_);
+        int largest = 0;
+        int default_weight = -1;
+        for (int i = 0; i < num_branches_; i++) {
+            int cls = class_idx_[i];
+            int weight = TotalWeight(split_table + cls * num_labels);
+            may_split[i] = ChildMaySplit(split_table + cls * num_labels, num_attrs);
+            if (begin[cls + 1] - begin[cls] > begin[class_idx_[largest] + 1] - begin[class_idx_[largest]]) {
+                largest = i;
+            }
+            // the tuple with the class unseen or missing follows the majority of the training tuples
+            if (weight > default_weight) {
+                default_weight = weight;
+                default_branch_ = i;
+            }
+        }
+
+        // subtract only if it counts less rows than counting the children directly
+        int **child_tables = scratch_->Alloc<int *>(num_branches_, nullptr);
+        bool **child_counted = scratch_->Alloc<bool *>(num_branches_, nullptr);
+        if (may_split[largest] && UseAllAttributes(num_attrs_) && UseAllAttributes(num_attrs)) {
+            long subtract_cost = 0;
+            long direct_cost = 0;
+            for (int i = 0; i < num_branches_; i++) {
+                long rows = begin[class_idx_[i] + 1] - begin[class_idx_[i]];
+                if (i != largest) {
+                    subtract_cost += rows;
+                }
+                if (may_split[i]) {
+                    direct_cost += rows;
+                }
+            }
+
+            if (subtract_cost < direct_cost) {
+                // the largest child takes over this node's tables
+                child_tables[largest] = info_tables_;
+                for (int i = 0; i < num_branches_; i++) {
+                    child_counted[i] = scratch_->Alloc<bool>(data_->num_attrs, false);
+                    for (int j = 0; j < num_attrs; j++) {
+                        child_counted[i][attrs[j]] = true;
+                    }
+                    if (i == largest) {
+                        continue;
+                    }
+
+                    int cls = class_idx_[i];
+                    child_tables[i] = scratch_->Alloc<int>(num_table);
+                    for (int j = 0; j < num_attrs; j++) {
+                        int offset = table_offset_[attrs[j]];
+                        int size = table_offset_[attrs[j] + 1] - offset;
+                        int *table = child_tables[i] + offset;
+                        int *derived = info_tables_ + offset;
+                        CountInfoTable(rows_ + begin[cls], begin[cls + 1] - begin[cls], attrs[j], table);
+                        for (int k = 0; k < size; k++) {
+                            derived[k] -= table[k];
+                        }
+                    }
+                }
             }
         }
 
-        size = cls_idx.size();
-        for (int i = 0; i < size; i++) {
-            branches_.push_back(DecisionTree (training_data_per_class[cls_idx[i]], attributes_, class_of_attr_));
+        // the split table is not touched by the subtraction, so it stays valid for the counts
+        branches_ = pool_->Alloc<DecisionTree>(num_branches_);
+        for (int i = 0; i < num_branches_; i++) {
+            int cls = class_idx_[i];
+            Arena::Marker marker = scratch_->Mark();
+            new (&branches_[i]) DecisionTree(*this, rows_ + begin[cls], begin[cls + 1] - begin[cls],
+                    attrs, num_attrs, split_table + cls * num_labels, child_tables[i], child_counted[i]);
+            scratch_->Reset(marker);
         }
     }
 
@@ -363,25 +678,25 @@ public:
             int finding_attr_idx = 0;
             for (auto attr : test_attr) {
                 if (attribute_ == attr) {
-                   break; 
+                   break;
                 } else {
                     finding_attr_idx++;
                 }
             }
 
-            unsigned int finding_cls_idx = 0;
-            for (auto cls : classes_) {
-                if (cls == tuple[finding_attr_idx]) {
-                   break; 
+            int finding_cls_idx = 0;
+            for (int i = 0; i < num_branches_; i++) {
+                if (data_->class_of_attr[attr_idx_][class_idx_[i]] == tuple[finding_attr_idx]) {
+                   break;
                 } else {
                     finding_cls_idx++;
                 }
             }
 
-            // if the tuple that the model cannot classify,
-            // select the first branch for decision making
-            if(branches_.size() <= finding_cls_idx) {
-                finding_cls_idx = 0;
+            // if the tuple that the model cannot classify(unseen or missing class),
+            // select the branch with the most training tuples
+            if(num_branches_ <= finding_cls_idx) {
+                finding_cls_idx = default_branch_;
             }
 
             return branches_[finding_cls_idx].SearchAttribute(tuple, test_attr);
@@ -389,9 +704,11 @@ public:
     }
 };
 
-void InitCLA(const char*[]);
+bool InitCLA(int, const char*[]);
+void SplitLine(string&, tuple_t&);
 void InitTrainingData();
 void BuildDecisionTree();
+void EncodeTestTuple(tuple_t&, vector<int>&, vector<int>&);
 void TestDecisionTree();
 
 #endif // __ASSIGNMENT2_INCLUDE_DECISION_TREE_H__
@@ -0,0 +1,135 @@
+/**
+ * Flattened decision tree for fast classification
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        flattree.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_FLAT_TREE_H__
+#define __ASSIGNMENT2_INCLUDE_FLAT_TREE_H__
+#include "decisiontree.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ * One node of the flattened tree
+ * Children of an internal node are found through the link table,
+ * one link per class of the split attribute and one more for the default child,
+ * which takes the class unseen in training(or missing, -1)
+ */
+struct FlatNode {
+    int attr; // index of the classifier attribute, -1 if the node is leaf
+    int label; // index of the decided(majority) class
+    int first; // offset of the first link of the node
+    int arity; // number of classes of the attribute, links[first + arity] is the default child
+};
+
+class FlatTree {
+public:
+    vector<FlatNode> nodes_; // nodes in depth-first order, root is the first one
+    vector<int> links_; // child node of each class of each internal node
+
+    // node and link arrays owned by a mapped model file instead of the vectors above
+    const FlatNode *mapped_nodes_ = nullptr;
+    const int *mapped_links_ = nullptr;
+    int num_mapped_nodes_ = 0;
+    int num_mapped_links_ = 0;
+
+    FlatTree() {}
+
+    /**
+     * Refer to the node and link arrays of a mapped model file without copying them
+     *
+     * @param[in]   nodes       node array
+     * @param[in]   num_nodes   number of nodes
+     * @param[in]   links       link array
+     * @param[in]   num_links   number of links
+     */
+    FlatTree(const FlatNode *nodes, int num_nodes, const int *links, int num_links)
+    : mapped_nodes_(nodes), mapped_links_(links),
+      num_mapped_nodes_(num_nodes), num_mapped_links_(num_links) {}
+
+    /**
+     * Flatten the trained decision tree into a node array
+     *
+     * @param[in]   tree    root of the trained decision tree
+     * @param[in]   data    training data the tree has been trained with
+     */
+    FlatTree(const DecisionTree &tree, const Dataset &data) {
+        Flatten(tree, data);
+    }
+
+    const FlatNode *Nodes() const {
+        return mapped_nodes_ != nullptr ? mapped_nodes_ : nodes_.data();
+    }
+
+    const int *Links() const {
+        return mapped_nodes_ != nullptr ? mapped_links_ : links_.data();
+    }
+
+    int NumNodes() const {
+        return mapped_nodes_ != nullptr ? num_mapped_nodes_ : nodes_.size();
+    }
+
+    int NumLinks() const {
+        return mapped_nodes_ != nullptr ? num_mapped_links_ : links_.size();
+    }
+
+    /**
+     * Classify one encoded tuple
+     * The tuple holds the class index of each attribute in the training data order
+     *
+     * @param[in]   row     encoded tuple, -1 for the class never seen
+     * return       index of the decided class
+     */
+    int Classify(const int *row) const {
+        const FlatNode *nodes = Nodes();
+        const int *links = Links();
+        const FlatNode *node = &nodes[0];
+        while (node->attr >= 0) {
+            // the class out of range(-1 included) goes to the default child without a branch
+            unsigned int cls = min((unsigned int)row[node->attr], (unsigned int)node->arity);
+            node = &nodes[links[node->first + cls]];
+        }
+        return node->label;
+    }
+
+private:
+    /**
+     * Append the node and its subtree in depth-first order
+     *
+     * @param[in]   tree    node of the trained decision tree
+     * @param[in]   data    training data the tree has been trained with
+     * return       index of the appended node
+     */
+    int Flatten(const DecisionTree &tree, const Dataset &data) {
+        int idx = nodes_.size();
+        nodes_.push_back(FlatNode { tree.attr_idx_, tree.label_idx_, 0, 0 });
+        if (tree.is_leaf_) {
+            return idx;
+        }
+
+        int first = links_.size();
+        int arity = data.class_of_attr[tree.attr_idx_].size();
+        nodes_[idx].first = first;
+        nodes_[idx].arity = arity;
+        links_.resize(first + arity + 1, -1);
+
+        for (int i = 0; i < tree.num_branches_; i++) {
+            int child = Flatten(tree.branches_[i], data);
+            links_[first + tree.class_idx_[i]] = child;
+        }
+
+        // the class without training data and the unseen class go to the default child
+        int default_child = links_[first + tree.class_idx_[tree.default_branch_]];
+        for (int i = 0; i <= arity; i++) {
+            if (links_[first + i] < 0) {
+                links_[first + i] = default_child;
+            }
+        }
+        return idx;
+    }
+};
+
+#endif // __ASSIGNMENT2_INCLUDE_FLAT_TREE_H__
@@ -0,0 +1,39 @@
+/**
+ * Random forest(bagged ensemble) of decision trees
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        forest.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_FOREST_H__
+#define __ASSIGNMENT2_INCLUDE_FOREST_H__
+#include "decisiontree.h"
+#include "flattree.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ * Options for growing a forest
+ */
+struct ForestConfig {
+    int num_trees = 1; // number of trees
+    int num_threads = 0; // number of training threads, 0 means number of cores
+    unsigned int seed = 0; // seed of the bootstrap samples and attribute subsets
+    TreeConfig tree; // options for growing each tree
+};
+
+class RandomForest {
+public:
+    vector<FlatTree> trees_; // flattened trees
+    int num_labels_; // number of classes being classified
+
+    RandomForest() : num_labels_(0) {}
+
+    void Train(const Dataset &data, ForestConfig config);
+    void Add(const DecisionTree &tree, const Dataset &data);
+    int Classify(const int *row) const;
+    void Classify(const int *rows, int num_rows, int stride, int *labels) const;
+};
+
+#endif // __ASSIGNMENT2_INCLUDE_FOREST_H__
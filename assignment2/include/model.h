@@ -0,0 +1,69 @@
+/**
+ * Binary model file of the trained decision tree(forest)
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        model.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_MODEL_H__
+#define __ASSIGNMENT2_INCLUDE_MODEL_H__
+#include "decisiontree.h"
+#include "flattree.h"
+#include "forest.h"
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+#define MODEL_MAGIC "DTMODEL"
+#define MODEL_VERSION 2
+
+/**
+ * Layout of the model file (every section is aligned to 8 bytes)
+ *  - ModelHeader
+ *  - ModelTree x num_trees
+ *  - attribute dictionary: for each attribute,
+ *      attribute name, number of classes, classes
+ *    where every string is a uint32_t length followed by its bytes
+ *  - node array(FlatNode) and link array(int) of each tree
+ */
+struct ModelHeader {
+    char magic[8]; // MODEL_MAGIC
+    uint32_t version; // MODEL_VERSION
+    uint32_t num_attrs; // number of attributes including the one being classified
+    uint32_t num_trees; // number of trees
+    uint32_t node_size; // sizeof(FlatNode) when the file was written
+    uint64_t dict_offset; // offset of the attribute dictionary
+    uint64_t file_size; // size of the whole file
+};
+
+struct ModelTree {
+    uint64_t node_offset; // offset of the node array
+    uint64_t link_offset; // offset of the link array
+    uint32_t num_nodes; // number of nodes
+    uint32_t num_links; // number of links
+};
+
+/**
+ * Model file mapped into memory
+ * The loaded trees refer to the mapped node arrays, so the file has to stay
+ * mapped while the model is used
+ */
+class ModelFile {
+public:
+    ModelFile() : addr_(NULL), size_(0) {}
+    ~ModelFile();
+
+    bool Load(const char *path, Dataset &data, RandomForest &forest);
+
+private:
+    void *addr_; // mapped address
+    size_t size_; // mapped size
+
+    ModelFile(const ModelFile &);
+    ModelFile &operator=(const ModelFile &);
+};
+
+bool SaveModel(const char *path, const Dataset &data, const RandomForest &forest);
+
+#endif // __ASSIGNMENT2_INCLUDE_MODEL_H__
@@ -0,0 +1,64 @@
+/**
+ * Streaming classification of the test set with overlapped parse/classify/write
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        pipeline.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_PIPELINE_H__
+#define __ASSIGNMENT2_INCLUDE_PIPELINE_H__
+#include "decisiontree.h"
+#include "forest.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Queue shared by the stages of the pipeline
+ * Pop blocks until an item is pushed
+ */
+template <typename T>
+class BlockingQueue {
+public:
+    void Push(T item) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            items_.push_back(item);
+        }
+        cond_.notify_one();
+    }
+
+    T Pop() {
+        unique_lock<mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !items_.empty(); });
+        T item = items_.front();
+        items_.pop_front();
+        return item;
+    }
+
+private:
+    deque<T> items_;
+    mutex mutex_;
+    condition_variable cond_;
+};
+
+/**
+ * Block of test lines travelling through the pipeline
+ */
+struct TestBatch {
+    vector<char> text; // complete lines of the block
+    vector<size_t> line_begin; // offset of each line in text
+    vector<size_t> line_len; // length of each line without the line feed
+    vector<int> rows; // encoded tuples
+    vector<int> labels; // index of the decided class of each tuple
+    bool done = false; // classified and ready to be written
+};
+
+void ClassifyPipeline(istream &in, ostream &out, const Dataset &data,
+        const RandomForest &forest, const vector<int> &columns, int num_workers);
+
+#endif // __ASSIGNMENT2_INCLUDE_PIPELINE_H__
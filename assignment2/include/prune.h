@@ -0,0 +1,27 @@
+/**
+ * Post-training pruning of the flattened decision tree against a holdout set
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        prune.h
+ */
+#ifndef __ASSIGNMENT2_INCLUDE_PRUNE_H__
+#define __ASSIGNMENT2_INCLUDE_PRUNE_H__
+#include "decisiontree.h"
+#include "flattree.h"
+#include <vector>
+
+using namespace std;
+
+enum class PruneMethod {
+    NONE,
+    REDUCED_ERROR, // prune bottom-up while the holdout error does not increase
+    COST_COMPLEXITY // weakest link pruning sequence, pick the best one on the holdout set
+};
+
+void SplitHoldout(int num_rows, double holdout_ratio, unsigned int seed,
+        vector<int> &weights, vector<int> &holdout_rows);
+void PruneTree(FlatTree &tree, const Dataset &data, const vector<int> &weights,
+        const vector<int> &holdout_rows, PruneMethod method);
+
+#endif // __ASSIGNMENT2_INCLUDE_PRUNE_H__
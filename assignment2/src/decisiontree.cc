@@ -7,36 +7,84 @@
  */
 
 #include "decisiontree.h"
+#include "forest.h"
+#include "pipeline.h"
+#include "model.h"
+#include "prune.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
 
 fstream  g_fs_training; // training file stream
 fstream  g_fs_test; // test file stream
 ofstream g_fs_result; // result file stream
-tuple_t g_attributes; // all attributes from training file
-vector<vector<class_t>> g_class_of_attr; // all classes for each attribute
-vector<tuple_t> g_training_data; // training data
+Dataset g_dataset; // encoded training data
 tuple_t g_test_attr; // all attributes from test file
-tuple_t g_test_data; // all testing tuple from test file
 DecisionTree *g_tree;
+RandomForest g_forest; // flattened trees used for classification
+ModelFile g_model_file; // mapped model file
+
+struct {
+    int num_trees = 0; // number of trees of the forest, 0 means a single decision tree
+    int num_threads = 0; // number of threads for training the forest, 0 means all cores
+    unsigned int seed = 0; // seed of the forest
+    int num_workers = 0; // number of classifier threads of the pipeline, 0 means serial
+    const char *save_path = NULL; // path to save the trained model
+    const char *load_path = NULL; // path to load the model from
+    PruneMethod prune = PruneMethod::NONE; // post-training pruning of the single tree
+    double holdout_ratio = 0.2; // ratio of the training data held out for pruning
+    TreeConfig tree; // options for growing each tree
+} g_config;
 
 /**
  * @param[in]   command line arguments as below:
  *              argv[0] executable file
- *              argv[1] training data file
+ *              argv[1] training data file (omitted with --load)
  *              argv[2] test data file
  *              argv[3] output file
+ *              options:
+ *              --forest N      train N trees on bootstrap samples and vote
+ *              --threads N     number of threads for training the forest
+ *              --features N    number of random candidate attributes per node
+ *              --seed N        seed of the bootstrap samples and attribute subsets
+ *              --pipeline N    classify the test file with N classifier threads while
+ *                              reading and writing on their own threads
+ *              --save PATH     save the trained model to the binary model file
+ *              --load PATH     load the model from the binary model file instead of training
+ *              --max-depth N   maximum depth of the tree
+ *              --min-leaf N    minimum number of tuples of every branch
+ *              --min-gain G    minimum gain of a split (information gain by default)
+ *              --criterion C   split criterion: ratio(information gain ratio), gini or chi2
+ *              --prune rep|ccp prune the single tree against the holdout rows with
+ *                              reduced error pruning or cost complexity pruning
+ *              --holdout R     ratio of the training data held out for pruning (0.2)
  * @return      0
  */
 int main(int argc, const char *argv[]) {
-    if (argc == 4) {
-        InitCLA(argv);
-        InitTrainingData();
-        BuildDecisionTree();
+    if (InitCLA(argc, argv)) {
+        if (g_config.load_path != NULL) {
+            if (g_model_file.Load(g_config.load_path, g_dataset, g_forest) == false) {
+                cout << "Can't load model file. Program terminated." << endl;
+                exit(0);
+            }
+        } else {
+            InitTrainingData();
+            BuildDecisionTree();
+        }
+        if (g_config.save_path != NULL && SaveModel(g_config.save_path, g_dataset, g_forest) == false) {
+            cout << "Can't save model file. Program terminated." << endl;
+            exit(0);
+        }
         TestDecisionTree();
     } else {
         cout << "Invalid usage. Please check the arguments." << endl
-           << "$ [executable file] [training file] [test file] [result file]" << endl;
+           << "$ [executable file] [training file] [test file] [result file] "
+           << "[--forest N] [--threads N] [--features N] [--seed N] [--pipeline N] "
+           << "[--save model file] [--max-depth N] [--min-leaf N] [--min-gain G] "
+           << "[--criterion ratio|gini|chi2] [--prune rep|ccp] [--holdout R]" << endl
+           << "$ [executable file] --load [model file] [test file] [result file] "
+           << "[--pipeline N]" << endl;
     }
 
     return 0;
@@ -44,79 +92,174 @@ int main(int argc, const char *argv[]) {
 
 /**
  * Open in/out file with Command Line Arguments
+ * Configuration setup
  *
+ * @param[in]   argc   number of command line arguments
  * @param[in]   argv   input command line arguments 
+ * @return      whether the usage is valid or not
  */
-void InitCLA(const char *argv[]) {
+bool InitCLA(int argc, const char *argv[]) {
+    vector<const char *> paths;
+
+    // setup the configuration value
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            paths.push_back(argv[i]);
+            continue;
+        } else if (i + 1 >= argc) {
+            return false;
+        }
+
+        if (strcmp(argv[i], "--forest") == 0) {
+            g_config.num_trees = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            g_config.num_threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--features") == 0) {
+            g_config.tree.max_features = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            g_config.seed = strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            g_config.num_workers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--save") == 0) {
+            g_config.save_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--load") == 0) {
+            g_config.load_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--max-depth") == 0) {
+            g_config.tree.max_depth = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--min-leaf") == 0) {
+            g_config.tree.min_samples_leaf = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--min-gain") == 0) {
+            g_config.tree.min_gain = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--criterion") == 0) {
+            if (strcmp(argv[i + 1], "ratio") == 0) {
+                g_config.tree.criterion = Criterion::GAIN_RATIO;
+            } else if (strcmp(argv[i + 1], "gini") == 0) {
+                g_config.tree.criterion = Criterion::GINI;
+            } else if (strcmp(argv[i + 1], "chi2") == 0) {
+                g_config.tree.criterion = Criterion::CHI_SQUARE;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--prune") == 0) {
+            if (strcmp(argv[i + 1], "rep") == 0) {
+                g_config.prune = PruneMethod::REDUCED_ERROR;
+            } else if (strcmp(argv[i + 1], "ccp") == 0) {
+                g_config.prune = PruneMethod::COST_COMPLEXITY;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--holdout") == 0) {
+            g_config.holdout_ratio = atof(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << argv[i] << ". Program terminated." << endl;
+            exit(0);
+        }
+        i++;
+    }
+
+    // training file is not needed if the model is loaded
+    if (paths.size() != (g_config.load_path != NULL ? 2u : 3u)) {
+        return false;
+    }
+    // pruning is for the single tree, the forest relies on unpruned trees
+    if (g_config.prune != PruneMethod::NONE && (g_config.num_trees > 0
+                || g_config.holdout_ratio <= 0 || g_config.holdout_ratio >= 1)) {
+        return false;
+    }
+
     // open training file
-    g_fs_training.open(argv[1], ifstream::in);
-    if (g_fs_training.is_open() == false) {
-        cout << "Can't open training file. Program terminated." << endl;
-        exit(0);
+    if (g_config.load_path == NULL) {
+        g_fs_training.open(paths[0], ifstream::in);
+        if (g_fs_training.is_open() == false) {
+            cout << "Can't open training file. Program terminated." << endl;
+            exit(0);
+        }
+        paths.erase(paths.begin());
     }
 
     // open test file
-    g_fs_test.open(argv[2], ifstream::in);
+    g_fs_test.open(paths[0], ifstream::in);
     if (g_fs_test.is_open() == false) {
         cout << "Can't open test file. Program terminated." << endl;
         exit(0);
     }
 
     // open result file
-    g_fs_result.open(argv[3], ofstream::out);
+    g_fs_result.open(paths[1], ofstream::out);
     if (g_fs_result.is_open() == false) {
         cout << "Can't open output file. Program terminated." << endl;
         exit(0);
     }
+
+    return true;
+}
+
+/**
+ * Split the line into tuple with the delimiter '\t'
+ * The carriage return of the line is removed
+ *
+ * @param[in]   input_line  line read from the file
+ * @param[out]  tuple       each attribute of the line
+ */
+void SplitLine(string &input_line, tuple_t &tuple) {
+    string delimiter = "\t";
+    size_t begin = 0;
+    size_t pos = 0;
+
+    // erase last carriage return character ('\r')
+    if (!input_line.empty() && input_line[input_line.size() - 1] == '\r') {
+        input_line.erase(input_line.size() - 1);
+    }
+
+    tuple.clear();
+    while ((pos = input_line.find(delimiter, begin)) != string::npos) {
+        tuple.push_back(input_line.substr(begin, pos - begin));
+        begin = pos + delimiter.length();
+    }
+    tuple.push_back(input_line.substr(begin));
 }
 
 /**
  * Initialize training data(tuples) by reading and parsing the input training file
+ * Every class is encoded into its index in the sorted classes of the attribute
  */
 void InitTrainingData() {
     tuple_t tuple;
     string input_line;
-    string attribute;
-    string delimiter = "\t";
-    size_t pos = 0;
+    vector<tuple_t> training_data;
 
     // read first line from training file to init attributes
     getline(g_fs_training, input_line);
-    // parse each attributes
-    while ((pos = input_line.find(delimiter)) != string::npos) {
-        attribute = input_line.substr(0, pos);
-        input_line.erase(0, pos + delimiter.length());
-        g_attributes.push_back(attribute);
-    }
-    // erase last new line character ('\n')
-    input_line.erase(input_line.end() - 1, input_line.end());
-    g_attributes.push_back(input_line);
-    g_class_of_attr.assign(g_attributes.size(), vector<class_t>());
-    set<class_t> set_of_class[g_attributes.size()];
-
-    int class_idx = 0;
+    SplitLine(input_line, g_dataset.attributes);
+    g_dataset.num_attrs = g_dataset.attributes.size();
+    vector<set<class_t>> set_of_class(g_dataset.num_attrs);
+
     // read every line from training file to init data tuple
     while (getline(g_fs_training, input_line)) {
-        tuple.clear();
-        class_idx = 0;
-        while ((pos = input_line.find(delimiter)) != string::npos) {
-            attribute = input_line.substr(0, pos);
-            input_line.erase(0, pos + delimiter.length());
-            tuple.push_back(attribute);
-            set_of_class[class_idx].insert(attribute);
-            class_idx++;
+        SplitLine(input_line, tuple);
+        if ((int)tuple.size() != g_dataset.num_attrs) {
+            continue;
+        }
+        for (int i = 0; i < g_dataset.num_attrs; i++) {
+            set_of_class[i].insert(tuple[i]);
         }
-        // erase last new line character ('\n')
-        input_line.erase(input_line.end() - 1, input_line.end());
-        tuple.push_back(input_line);
-        set_of_class[class_idx].insert(input_line);
-        g_training_data.push_back(tuple);
+        training_data.push_back(tuple);
     }
 
     // transform classes of attribute from set to vector
-    for (unsigned int i = 0; i < g_class_of_attr.size(); i++) {
+    g_dataset.class_of_attr.assign(g_dataset.num_attrs, vector<class_t>());
+    for (int i = 0; i < g_dataset.num_attrs; i++) {
         for (auto cls : set_of_class[i]) {
-           g_class_of_attr[i].push_back(cls); 
+           g_dataset.class_of_attr[i].push_back(cls); 
+        }
+    }
+
+    // encode the tuples
+    g_dataset.num_rows = training_data.size();
+    g_dataset.codes.reserve(g_dataset.num_rows * g_dataset.num_attrs);
+    for (auto &tuple : training_data) {
+        for (int i = 0; i < g_dataset.num_attrs; i++) {
+            g_dataset.codes.push_back(g_dataset.Encode(i, tuple[i]));
         }
     }
 
@@ -125,9 +268,48 @@ void InitTrainingData() {
 
 /**
  * Build the classification model with decision tree
+ * With the forest option, build the trees on bootstrap samples in parallel
+ * With the prune option, hold out some rows for pruning the tree after training
  */
 void BuildDecisionTree() {
-    g_tree = new DecisionTree(g_training_data, g_attributes, g_class_of_attr);
+    if (g_config.num_trees > 0) {
+        ForestConfig config;
+        config.num_trees = g_config.num_trees;
+        config.num_threads = g_config.num_threads;
+        config.seed = g_config.seed;
+        config.tree = g_config.tree;
+        g_forest.Train(g_dataset, config);
+    } else if (g_config.prune != PruneMethod::NONE) {
+        // train with the rest of the holdout rows, then prune against the holdout rows
+        vector<int> weights;
+        vector<int> holdout_rows;
+        SplitHoldout(g_dataset.num_rows, g_config.holdout_ratio, g_config.seed,
+                weights, holdout_rows);
+        g_tree = new DecisionTree(g_dataset, g_config.tree, &weights);
+        g_forest.Add(*g_tree, g_dataset);
+
+        PruneTree(g_forest.trees_[0], g_dataset, weights, holdout_rows, g_config.prune);
+    } else {
+        g_tree = new DecisionTree(g_dataset, g_config.tree);
+        g_forest.Add(*g_tree, g_dataset);
+    }
+}
+
+/**
+ * Encode the test tuple into the class index of each training attribute
+ *
+ * @param[in]   tuple       test tuple
+ * @param[in]   columns     column of each training attribute in the test file, -1 if absent
+ * @param[out]  row         encoded tuple
+ */
+void EncodeTestTuple(tuple_t &tuple, vector<int> &columns, vector<int> &row) {
+    int size = columns.size();
+    row.assign(size, -1);
+    for (int i = 0; i < size; i++) {
+        if (columns[i] >= 0 && columns[i] < (int)tuple.size()) {
+            row[i] = g_dataset.Encode(i, tuple[columns[i]]);
+        }
+    }
 }
 
 /**
@@ -135,50 +317,56 @@ void BuildDecisionTree() {
  */
 void TestDecisionTree() {
     string input_line;
-    string attribute;
-    string delimiter = "\t";
-    size_t pos = 0;
 
     // read first line from test file to init attributes
     getline(g_fs_test, input_line);
-    // parse each attributes
-    while ((pos = input_line.find(delimiter)) != string::npos) {
-        attribute = input_line.substr(0, pos);
-        input_line.erase(0, pos + delimiter.length());
-        g_test_attr.push_back(attribute);
+    SplitLine(input_line, g_test_attr);
+
+    // find the column of each training attribute in the test file
+    int finding_attr_idx = g_dataset.LabelIdx();
+    vector<int> columns(finding_attr_idx, -1);
+    for (int i = 0; i < finding_attr_idx; i++) {
+        for (unsigned int j = 0; j < g_test_attr.size(); j++) {
+            if (g_test_attr[j] == g_dataset.attributes[i]) {
+                columns[i] = j;
+                break;
+            }
+        }
     }
-    // erase last new line character ('\n')
-    input_line.erase(input_line.end() - 1, input_line.end());
-    g_test_attr.push_back(input_line);
 
     // print the attributes to result file
-    int size = g_attributes.size();
+    int size = g_dataset.attributes.size();
     for (int i = 0; i < size; i++) {
-        g_fs_result << g_attributes[i];
+        g_fs_result << g_dataset.attributes[i];
         if (i < size - 1) {
            g_fs_result << "\t"; 
         }
     }
-    g_fs_result << endl;
+    g_fs_result << "\n";
+
+    // classify the rest of the file with the pipeline of threads
+    if (g_config.num_workers > 0) {
+        ClassifyPipeline(g_fs_test, g_fs_result, g_dataset, g_forest, columns,
+                g_config.num_workers);
+        g_fs_test.close();
+        g_fs_result.close();
+        return;
+    }
 
     tuple_t tuple;
-    string classified_attr;
+    vector<int> row;
     // read every line from test file to init test tuple
     while (getline(g_fs_test, input_line)) {
-        tuple.clear();
-        classified_attr.clear();
-        while ((pos = input_line.find(delimiter)) != string::npos) {
-            attribute = input_line.substr(0, pos);
-            input_line.erase(0, pos + delimiter.length());
-            tuple.push_back(attribute);
+        SplitLine(input_line, tuple);
+        // skip the empty line
+        if (tuple.size() == 1 && tuple[0].empty()) {
+            continue;
         }
-        // erase last new line character ('\n')
-        input_line.erase(input_line.end() - 1, input_line.end());
-        tuple.push_back(input_line);
 
         // Classfy the test tuple by searching decision tree
-        classified_attr = g_tree->SearchAttribute(tuple, g_test_attr);
-        tuple.push_back(classified_attr);
+        EncodeTestTuple(tuple, columns, row);
+        int label = g_forest.Classify(row.data());
+        tuple.push_back(g_dataset.class_of_attr[finding_attr_idx][label]);
 
         // print the result tuple to result file
         int size = tuple.size();
@@ -188,7 +376,7 @@ void TestDecisionTree() {
                g_fs_result << "\t"; 
             }
         }
-        g_fs_result << endl;
+        g_fs_result << "\n";
     }
 
     g_fs_test.close();
@@ -0,0 +1,128 @@
+/**
+ * Random forest(bagged ensemble) of decision trees
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        forest.cc
+ */
+
+#include "forest.h"
+#include <thread>
+#include <atomic>
+#include <cmath>
+
+#define CLASSIFY_BLOCK 256 // number of tuples classified by every tree at once
+
+/**
+ * Train the trees in parallel
+ * Each tree is trained on its own bootstrap sample, which is the number of times
+ * each row was drawn (row weight) over the shared training data.
+ * The sample of tree i only depends on seed + i, so the forest is the same
+ * regardless of the number of threads.
+ *
+ * @param[in]   data      training data shared by every tree
+ * @param[in]   config    options for growing the forest
+ */
+void RandomForest::Train(const Dataset &data, ForestConfig config) {
+    int num_features = data.LabelIdx();
+    if (config.tree.max_features <= 0) {
+        config.tree.max_features = max(1, (int)sqrt((double)num_features));
+    }
+    if (config.num_threads <= 0) {
+        config.num_threads = max(1, (int)thread::hardware_concurrency());
+    }
+    config.num_threads = min(config.num_threads, config.num_trees);
+
+    num_labels_ = data.class_of_attr[data.LabelIdx()].size();
+    trees_.assign(config.num_trees, FlatTree());
+
+    atomic<int> next_tree(0);
+    auto worker = [&]() {
+        vector<int> weights(data.num_rows);
+        int i;
+        while ((i = next_tree++) < config.num_trees) {
+            mt19937 rng(config.seed + i);
+
+            // draw num_rows rows with replacement
+            fill(weights.begin(), weights.end(), 0);
+            if (data.num_rows > 0) {
+                uniform_int_distribution<int> dist(0, data.num_rows - 1);
+                for (int j = 0; j < data.num_rows; j++) {
+                    weights[dist(rng)]++;
+                }
+            }
+
+            DecisionTree tree(data, config.tree, &weights, &rng);
+            trees_[i] = FlatTree(tree, data);
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 1; t < config.num_threads; t++) {
+        threads.push_back(thread(worker));
+    }
+    worker();
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+/**
+ * Add the trained decision tree to the forest
+ *
+ * @param[in]   tree    root of the trained decision tree
+ * @param[in]   data    training data the tree has been trained with
+ */
+void RandomForest::Add(const DecisionTree &tree, const Dataset &data) {
+    num_labels_ = data.class_of_attr[data.LabelIdx()].size();
+    trees_.push_back(FlatTree(tree, data));
+}
+
+/**
+ * Classify one encoded tuple by majority voting of the trees
+ *
+ * @param[in]   row     encoded tuple
+ * return       index of the decided class
+ */
+int RandomForest::Classify(const int *row) const {
+    int label;
+    Classify(row, 1, 0, &label);
+    return label;
+}
+
+/**
+ * Classify the encoded tuples by majority voting of the trees
+ * Tuples are classified by blocks, and every tree walks the whole block
+ * before the next tree so that the tree nodes stay in cache.
+ * Ties are broken by the smaller class index.
+ *
+ * @param[in]   rows        encoded tuples
+ * @param[in]   num_rows    number of tuples
+ * @param[in]   stride      distance between two consecutive tuples
+ * @param[out]  labels      index of the decided class of each tuple
+ */
+void RandomForest::Classify(const int *rows, int num_rows, int stride, int *labels) const {
+    if (trees_.size() == 1) {
+        for (int i = 0; i < num_rows; i++) {
+            labels[i] = trees_[0].Classify(rows + (size_t)i * stride);
+        }
+        return;
+    }
+
+    vector<int> votes(CLASSIFY_BLOCK * num_labels_);
+    for (int begin = 0; begin < num_rows; begin += CLASSIFY_BLOCK) {
+        int end = min(num_rows, begin + CLASSIFY_BLOCK);
+        fill(votes.begin(), votes.end(), 0);
+
+        for (auto &tree : trees_) {
+            for (int i = begin; i < end; i++) {
+                votes[(i - begin) * num_labels_ + tree.Classify(rows + (size_t)i * stride)]++;
+            }
+        }
+
+        for (int i = begin; i < end; i++) {
+            int *vote = &votes[(i - begin) * num_labels_];
+            labels[i] = max_element(vote, vote + num_labels_) - vote;
+        }
+    }
+}
@@ -0,0 +1,220 @@
+/**
+ * Binary model file of the trained decision tree(forest)
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        model.cc
+ */
+
+#include "model.h"
+#include <fstream>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Pad the buffer to the 8 bytes boundary
+ */
+static void Align(string &buf) {
+    buf.resize((buf.size() + 7) & ~(size_t)7, '\0');
+}
+
+static void AppendU32(string &buf, uint32_t value) {
+    buf.append((const char *)&value, sizeof(value));
+}
+
+static void AppendString(string &buf, const string &str) {
+    AppendU32(buf, str.size());
+    buf.append(str);
+}
+
+/**
+ * Save the trained model to the binary model file
+ *
+ * @param[in]   path        path of the model file
+ * @param[in]   data        training data the model has been trained with
+ * @param[in]   forest      trained model
+ * @return      whether saved or not
+ */
+bool SaveModel(const char *path, const Dataset &data, const RandomForest &forest) {
+    ModelHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = MODEL_VERSION;
+    header.num_attrs = data.num_attrs;
+    header.num_trees = forest.trees_.size();
+    header.node_size = sizeof(FlatNode);
+
+    string buf(sizeof(ModelHeader) + sizeof(ModelTree) * header.num_trees, '\0');
+
+    // attribute dictionary
+    header.dict_offset = buf.size();
+    for (int i = 0; i < data.num_attrs; i++) {
+        AppendString(buf, data.attributes[i]);
+        AppendU32(buf, data.class_of_attr[i].size());
+        for (auto &cls : data.class_of_attr[i]) {
+            AppendString(buf, cls);
+        }
+    }
+
+    // node and link arrays
+    vector<ModelTree> trees(header.num_trees);
+    for (unsigned int i = 0; i < header.num_trees; i++) {
+        const FlatTree &tree = forest.trees_[i];
+        trees[i].num_nodes = tree.NumNodes();
+        trees[i].num_links = tree.NumLinks();
+
+        Align(buf);
+        trees[i].node_offset = buf.size();
+        buf.append((const char *)tree.Nodes(), sizeof(FlatNode) * trees[i].num_nodes);
+        Align(buf);
+        trees[i].link_offset = buf.size();
+        buf.append((const char *)tree.Links(), sizeof(int) * trees[i].num_links);
+    }
+    Align(buf);
+
+    header.file_size = buf.size();
+    memcpy(&buf[0], &header, sizeof(header));
+    if (header.num_trees > 0) {
+        memcpy(&buf[sizeof(header)], trees.data(), sizeof(ModelTree) * header.num_trees);
+    }
+
+    ofstream fs_model(path, ofstream::out | ofstream::binary);
+    if (fs_model.is_open() == false) {
+        return false;
+    }
+    fs_model.write(buf.data(), buf.size());
+    return fs_model.good();
+}
+
+ModelFile::~ModelFile() {
+    if (addr_ != NULL) {
+        munmap(addr_, size_);
+    }
+}
+
+/**
+ * Map the model file and load the model from it
+ * The node arrays are used in place, only the dictionary is copied
+ *
+ * @param[in]   path        path of the model file
+ * @param[out]  data        attributes and their classes (no tuple)
+ * @param[out]  forest      loaded model
+ * @return      whether loaded or not
+ */
+bool ModelFile::Load(const char *path, Dataset &data, RandomForest &forest) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ModelHeader)) {
+        close(fd);
+        return false;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    addr_ = addr;
+    size_ = st.st_size;
+
+    const char *base = (const char *)addr;
+    const ModelHeader *header = (const ModelHeader *)base;
+    if (strncmp(header->magic, MODEL_MAGIC, sizeof(header->magic)) != 0
+            || header->version != MODEL_VERSION
+            || header->node_size != sizeof(FlatNode)
+            || header->file_size != size_
+            || header->num_attrs == 0
+            || sizeof(ModelHeader) + sizeof(ModelTree) * (uint64_t)header->num_trees
+                > header->dict_offset
+            || header->dict_offset > size_
+            || header->num_attrs > INT_MAX
+            // every attribute takes at least a name length and a number of classes
+            || header->num_attrs > (size_ - header->dict_offset) / (2 * sizeof(uint32_t))) {
+        return false;
+    }
+
+    // attribute dictionary
+    size_t pos = header->dict_offset;
+    auto read_u32 = [&](uint32_t &value) {
+        if (pos + sizeof(value) > size_) {
+            return false;
+        }
+        memcpy(&value, base + pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    };
+    auto read_string = [&](string &str) {
+        uint32_t len;
+        if (read_u32(len) == false || pos + len > size_) {
+            return false;
+        }
+        str.assign(base + pos, len);
+        pos += len;
+        return true;
+    };
+
+    data = Dataset();
+    data.num_attrs = header->num_attrs;
+    data.attributes.resize(data.num_attrs);
+    data.class_of_attr.resize(data.num_attrs);
+    for (int i = 0; i < data.num_attrs; i++) {
+        uint32_t num_classes;
+        if (read_string(data.attributes[i]) == false || read_u32(num_classes) == false
+                || num_classes > (size_ - pos) / sizeof(uint32_t)) {
+            return false;
+        }
+        data.class_of_attr[i].resize(num_classes);
+        for (auto &cls : data.class_of_attr[i]) {
+            if (read_string(cls) == false) {
+                return false;
+            }
+        }
+    }
+
+    // node and link arrays are used in place
+    int num_labels = data.class_of_attr[data.LabelIdx()].size();
+    const ModelTree *trees = (const ModelTree *)(base + sizeof(ModelHeader));
+    forest.trees_.clear();
+    forest.num_labels_ = num_labels;
+    for (unsigned int i = 0; i < header->num_trees; i++) {
+        const ModelTree &tree = trees[i];
+        if (tree.num_nodes == 0
+                || tree.node_offset % 8 != 0 || tree.link_offset % 8 != 0
+                || tree.node_offset + sizeof(FlatNode) * (uint64_t)tree.num_nodes > size_
+                || tree.link_offset + sizeof(int) * (uint64_t)tree.num_links > size_) {
+            return false;
+        }
+
+        // check the references of every node not to walk out of the arrays
+        // children always follow their parent in depth-first order
+        const FlatNode *nodes = (const FlatNode *)(base + tree.node_offset);
+        const int *links = (const int *)(base + tree.link_offset);
+        for (int j = 0; j < (int)tree.num_nodes; j++) {
+            const FlatNode &node = nodes[j];
+            if (node.label < 0 || node.label >= num_labels) {
+                return false;
+            }
+            if (node.attr < 0) {
+                continue;
+            }
+            if (node.attr >= data.LabelIdx() || node.arity <= 0 || node.first < 0
+                    || (uint64_t)node.first + node.arity + 1 > tree.num_links) {
+                return false;
+            }
+            for (int k = node.first; k <= node.first + node.arity; k++) {
+                if (links[k] <= j || links[k] >= (int)tree.num_nodes) {
+                    return false;
+                }
+            }
+        }
+
+        forest.trees_.push_back(FlatTree(nodes, tree.num_nodes, links, tree.num_links));
+    }
+    return true;
+}
@@ -0,0 +1,200 @@
+/**
+ * Streaming classification of the test set with overlapped parse/classify/write
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        pipeline.cc
+ */
+
+#include "pipeline.h"
+#include <thread>
+#include <cstring>
+
+#define READ_BLOCK (4 << 20) // bytes read from the test file at once
+#define WRITE_BLOCK (8 << 20) // bytes buffered before writing to the result file
+
+/**
+ * Split the block into lines and encode each tuple
+ * Empty lines are skipped
+ *
+ * @param[in]   data            training data the model has been trained with
+ * @param[in]   attr_of_column  training attribute of each test column, -1 if unused
+ * @param[out]  batch           block of lines to be parsed
+ */
+static void ParseBatch(const Dataset &data, const vector<int> &attr_of_column, TestBatch *batch) {
+    int num_features = data.LabelIdx();
+    int num_columns = attr_of_column.size();
+    const char *text = batch->text.data();
+    size_t size = batch->text.size();
+
+    batch->line_begin.clear();
+    batch->line_len.clear();
+    batch->rows.clear();
+
+    size_t begin = 0;
+    while (begin < size) {
+        const char *line_feed = (const char *)memchr(text + begin, '\n', size - begin);
+        size_t end = line_feed == NULL ? size : line_feed - text;
+        size_t len = end - begin;
+        // erase last carriage return character ('\r')
+        if (len > 0 && text[begin + len - 1] == '\r') {
+            len--;
+        }
+
+        if (len > 0) {
+            batch->line_begin.push_back(begin);
+            batch->line_len.push_back(len);
+            size_t base = batch->rows.size();
+            batch->rows.resize(base + num_features, -1);
+
+            // encode each column of the tuple
+            size_t field = begin;
+            size_t line_end = begin + len;
+            for (int column = 0; column < num_columns && field <= line_end; column++) {
+                const char *tab = (const char *)memchr(text + field, '\t', line_end - field);
+                size_t field_end = tab == NULL ? line_end : tab - text;
+                int attr = attr_of_column[column];
+                if (attr >= 0) {
+                    batch->rows[base + attr] = data.Encode(attr, text + field, field_end - field);
+                }
+                field = field_end + 1;
+            }
+        }
+        begin = end + 1;
+    }
+}
+
+/**
+ * Classify the test file with a pipeline of threads
+ *  - reader: reads large blocks, cuts them at line boundary and encodes the tuples
+ *  - workers: classify the encoded tuples of a block with the forest
+ *  - writer: writes the classified blocks in the input order through a large buffer
+ * The number of blocks is fixed, so memory is bounded regardless of the file size.
+ *
+ * @param[in]   in              test file positioned after the attribute line
+ * @param[in]   out             result file positioned after the attribute line
+ * @param[in]   data            training data the model has been trained with
+ * @param[in]   forest          trained model
+ * @param[in]   columns         column of each training attribute in the test file, -1 if absent
+ * @param[in]   num_workers     number of classifier threads
+ */
+void ClassifyPipeline(istream &in, ostream &out, const Dataset &data,
+        const RandomForest &forest, const vector<int> &columns, int num_workers) {
+    if (num_workers <= 0) {
+        num_workers = max(1, (int)thread::hardware_concurrency());
+    }
+
+    // training attribute of each test column
+    vector<int> attr_of_column;
+    for (unsigned int i = 0; i < columns.size(); i++) {
+        if (columns[i] >= 0) {
+            if ((int)attr_of_column.size() <= columns[i]) {
+                attr_of_column.resize(columns[i] + 1, -1);
+            }
+            attr_of_column[columns[i]] = i;
+        }
+    }
+
+    int num_batches = num_workers * 2 + 2;
+    vector<TestBatch> batches(num_batches);
+    BlockingQueue<TestBatch *> free_batches;
+    BlockingQueue<TestBatch *> work_batches;
+    BlockingQueue<TestBatch *> write_batches;
+    for (auto &batch : batches) {
+        free_batches.Push(&batch);
+    }
+
+    mutex done_mutex;
+    condition_variable done_cond;
+
+    auto reader = [&]() {
+        vector<char> carry; // incomplete last line of the previous block
+        bool eof = false;
+        while (!eof) {
+            TestBatch *batch = free_batches.Pop();
+            batch->text.swap(carry);
+            size_t old_size = batch->text.size();
+            batch->text.resize(old_size + READ_BLOCK);
+            in.read(batch->text.data() + old_size, READ_BLOCK);
+            batch->text.resize(old_size + in.gcount());
+            eof = !in;
+
+            if (!eof) {
+                // cut the block at the last line feed
+                size_t pos = batch->text.size();
+                while (pos > 0 && batch->text[pos - 1] != '\n') {
+                    pos--;
+                }
+                if (pos == 0) {
+                    // no complete line yet, keep reading
+                    carry.swap(batch->text);
+                    free_batches.Push(batch);
+                    continue;
+                }
+                carry.assign(batch->text.begin() + pos, batch->text.end());
+                batch->text.resize(pos);
+            }
+
+            ParseBatch(data, attr_of_column, batch);
+            batch->done = false;
+            work_batches.Push(batch);
+            write_batches.Push(batch);
+        }
+
+        for (int i = 0; i < num_workers; i++) {
+            work_batches.Push(NULL);
+        }
+        write_batches.Push(NULL);
+    };
+
+    auto worker = [&]() {
+        int num_features = data.LabelIdx();
+        TestBatch *batch;
+        while ((batch = work_batches.Pop()) != NULL) {
+            int num_rows = batch->line_len.size();
+            batch->labels.resize(num_rows);
+            forest.Classify(batch->rows.data(), num_rows, num_features, batch->labels.data());
+            {
+                lock_guard<mutex> lock(done_mutex);
+                batch->done = true;
+            }
+            done_cond.notify_all();
+        }
+    };
+
+    vector<thread> threads;
+    threads.push_back(thread(reader));
+    for (int i = 0; i < num_workers; i++) {
+        threads.push_back(thread(worker));
+    }
+
+    // writer
+    const vector<class_t> &labels = data.class_of_attr[data.LabelIdx()];
+    string buffer;
+    buffer.reserve(WRITE_BLOCK + READ_BLOCK);
+    TestBatch *batch;
+    while ((batch = write_batches.Pop()) != NULL) {
+        {
+            unique_lock<mutex> lock(done_mutex);
+            done_cond.wait(lock, [batch] { return batch->done; });
+        }
+
+        int num_rows = batch->line_len.size();
+        for (int i = 0; i < num_rows; i++) {
+            buffer.append(batch->text.data() + batch->line_begin[i], batch->line_len[i]);
+            buffer += '\t';
+            buffer += labels[batch->labels[i]];
+            buffer += '\n';
+            if (buffer.size() >= WRITE_BLOCK) {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        free_batches.Push(batch);
+    }
+    out.write(buffer.data(), buffer.size());
+
+    for (auto &t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,264 @@
+/**
+ * Post-training pruning of the flattened decision tree against a holdout set
+ *
+ * @author      Kwangil Cho
+ * @since       2017-03-31
+ * @file        prune.cc
+ */
+
+#include "prune.h"
+#include <queue>
+#include <numeric>
+#include <algorithm>
+
+/**
+ * Split the training data into the rows for training and the holdout rows for pruning
+ *
+ * @param[in]   num_rows        number of rows of the training data
+ * @param[in]   holdout_ratio   ratio of the holdout rows
+ * @param[in]   seed            seed of the split
+ * @param[out]  weights         1 for the rows for training, 0 for the holdout rows
+ * @param[out]  holdout_rows    holdout rows
+ */
+void SplitHoldout(int num_rows, double holdout_ratio, unsigned int seed,
+        vector<int> &weights, vector<int> &holdout_rows) {
+    vector<int> order(num_rows);
+    iota(order.begin(), order.end(), 0);
+    mt19937 rng(seed);
+    shuffle(order.begin(), order.end(), rng);
+
+    int num_holdout = num_rows * holdout_ratio;
+    holdout_rows.assign(order.begin(), order.begin() + num_holdout);
+    sort(holdout_rows.begin(), holdout_rows.end());
+
+    weights.assign(num_rows, 1);
+    for (auto row : holdout_rows) {
+        weights[row] = 0;
+    }
+}
+
+/**
+ * Add the misclassified weight of the tuple to every node on its path
+ * as if each node was a leaf
+ *
+ * @param[in]   tree        flattened tree
+ * @param[in]   tuple       encoded tuple of the training data
+ * @param[in]   label       class of the tuple being classified
+ * @param[in]   weight      weight of the tuple
+ * @param[out]  errors      misclassified weight of each node
+ */
+static void AddErrors(const FlatTree &tree, const int *tuple, int label, int weight,
+        vector<long> &errors) {
+    const FlatNode *nodes = tree.Nodes();
+    const int *links = tree.Links();
+    int i = 0;
+    while (true) {
+        if (nodes[i].label != label) {
+            errors[i] += weight;
+        }
+        if (nodes[i].attr < 0) {
+            break;
+        }
+        unsigned int cls = min((unsigned int)tuple[nodes[i].attr], (unsigned int)nodes[i].arity);
+        i = links[nodes[i].first + cls];
+    }
+}
+
+/**
+ * Remove the subtrees below the pruned nodes and make the pruned nodes leaves
+ * The depth-first order of the remaining nodes is kept
+ *
+ * @param[in]   parent      parent of each node
+ * @param[in]   pruned      whether each node is pruned into a leaf
+ * @param[out]  tree        flattened tree to be compacted
+ */
+static void Compact(const vector<int> &parent, const vector<bool> &pruned, FlatTree &tree) {
+    int num_nodes = tree.nodes_.size();
+    vector<bool> removed(num_nodes, false);
+    vector<int> new_idx(num_nodes, -1);
+    vector<FlatNode> nodes;
+    vector<int> links;
+
+    for (int i = 0; i < num_nodes; i++) {
+        int p = parent[i];
+        if (p >= 0 && (removed[p] || pruned[p])) {
+            removed[i] = true;
+            continue;
+        }
+        new_idx[i] = nodes.size();
+        nodes.push_back(tree.nodes_[i]);
+        if (pruned[i]) {
+            nodes.back().attr = -1;
+            nodes.back().first = 0;
+            nodes.back().arity = 0;
+        }
+    }
+
+    for (auto &node : nodes) {
+        if (node.attr < 0) {
+            continue;
+        }
+        int first = links.size();
+        for (int k = node.first; k <= node.first + node.arity; k++) {
+            links.push_back(new_idx[tree.links_[k]]);
+        }
+        node.first = first;
+    }
+
+    tree.nodes_.swap(nodes);
+    tree.links_.swap(links);
+}
+
+/**
+ * Prune the flattened tree without rebuilding it
+ *
+ * Reduced error pruning: from the bottom, make the node a leaf(its majority class)
+ * if that does not increase the error on the holdout rows.
+ *
+ * Cost complexity pruning: repeatedly prune the weakest link, the node with the smallest
+ *   alpha = (R(t) - R(T_t)) / (|leaves(T_t)| - 1)
+ * where R is the misclassified training weight, and keep the tree of the sequence with
+ * the smallest holdout error (the smaller tree on ties).
+ *
+ * @param[out]  tree            flattened tree trained with the weights
+ * @param[in]   data            training data
+ * @param[in]   weights         weight of each row the tree has been trained with
+ * @param[in]   holdout_rows    rows of the training data held out for pruning
+ * @param[in]   method          pruning method
+ */
+void PruneTree(FlatTree &tree, const Dataset &data, const vector<int> &weights,
+        const vector<int> &holdout_rows, PruneMethod method) {
+    if (method == PruneMethod::NONE || tree.mapped_nodes_ != nullptr) {
+        return;
+    }
+
+    int num_nodes = tree.nodes_.size();
+    const vector<FlatNode> &nodes = tree.nodes_;
+    int finding_attr_idx = data.LabelIdx();
+
+    // parent of each node (a child may be linked from several classes)
+    vector<int> parent(num_nodes, -1);
+    for (int i = 0; i < num_nodes; i++) {
+        if (nodes[i].attr < 0) {
+            continue;
+        }
+        for (int k = nodes[i].first; k < nodes[i].first + nodes[i].arity; k++) {
+            parent[tree.links_[k]] = i;
+        }
+    }
+
+    // holdout error of each node as if it was a leaf
+    vector<long> holdout_err(num_nodes, 0);
+    for (auto row : holdout_rows) {
+        const int *tuple = &data.codes[(size_t)row * data.num_attrs];
+        AddErrors(tree, tuple, tuple[finding_attr_idx], 1, holdout_err);
+    }
+
+    vector<bool> pruned(num_nodes, false);
+    if (method == PruneMethod::REDUCED_ERROR) {
+        // children always follow their parent, so visit the nodes backward
+        vector<long> subtree_err(num_nodes, 0);
+        for (int i = num_nodes - 1; i >= 0; i--) {
+            if (nodes[i].attr < 0 || holdout_err[i] <= subtree_err[i]) {
+                pruned[i] = nodes[i].attr >= 0;
+                subtree_err[i] = holdout_err[i];
+            }
+            if (parent[i] >= 0) {
+                subtree_err[parent[i]] += subtree_err[i];
+            }
+        }
+        Compact(parent, pruned, tree);
+        return;
+    }
+
+    // training error of each node as if it was a leaf
+    vector<long> train_err(num_nodes, 0);
+    for (int row = 0; row < data.num_rows; row++) {
+        if (weights[row] > 0) {
+            const int *tuple = &data.codes[(size_t)row * data.num_attrs];
+            AddErrors(tree, tuple, tuple[finding_attr_idx], weights[row], train_err);
+        }
+    }
+
+    // training error, holdout error and number of leaves of each subtree
+    vector<long> subtree_train_err(num_nodes, 0);
+    vector<long> subtree_holdout_err(num_nodes, 0);
+    vector<long> num_leaves(num_nodes, 0);
+    for (int i = num_nodes - 1; i >= 0; i--) {
+        if (nodes[i].attr < 0) {
+            subtree_train_err[i] = train_err[i];
+            subtree_holdout_err[i] = holdout_err[i];
+            num_leaves[i] = 1;
+        }
+        if (parent[i] >= 0) {
+            subtree_train_err[parent[i]] += subtree_train_err[i];
+            subtree_holdout_err[parent[i]] += subtree_holdout_err[i];
+            num_leaves[parent[i]] += num_leaves[i];
+        }
+    }
+
+    auto alpha = [&](int i) {
+        if (num_leaves[i] <= 1) {
+            return 0.0;
+        }
+        return (double)(train_err[i] - subtree_train_err[i]) / (num_leaves[i] - 1);
+    };
+    auto is_removed = [&](int i) {
+        for (int p = i; p >= 0; p = parent[p]) {
+            if (pruned[p]) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // weakest link first, the ancestor first on ties
+    typedef pair<double, int> link_t;
+    priority_queue<link_t, vector<link_t>, greater<link_t>> weakest_links;
+    for (int i = 0; i < num_nodes; i++) {
+        if (nodes[i].attr >= 0) {
+            weakest_links.push(link_t(alpha(i), i));
+        }
+    }
+
+    vector<int> sequence;
+    long error = subtree_holdout_err[0];
+    long best_error = error;
+    size_t best_len = 0;
+    while (!weakest_links.empty()) {
+        link_t link = weakest_links.top();
+        weakest_links.pop();
+        int i = link.second;
+        // skip the stale entry
+        if (is_removed(i) || link.first != alpha(i)) {
+            continue;
+        }
+
+        long delta_train = train_err[i] - subtree_train_err[i];
+        long delta_holdout = holdout_err[i] - subtree_holdout_err[i];
+        long delta_leaves = num_leaves[i] - 1;
+        pruned[i] = true;
+        subtree_train_err[i] = train_err[i];
+        subtree_holdout_err[i] = holdout_err[i];
+        num_leaves[i] = 1;
+        for (int p = parent[i]; p >= 0; p = parent[p]) {
+            subtree_train_err[p] += delta_train;
+            subtree_holdout_err[p] += delta_holdout;
+            num_leaves[p] -= delta_leaves;
+            weakest_links.push(link_t(alpha(p), p));
+        }
+
+        error += delta_holdout;
+        sequence.push_back(i);
+        if (error <= best_error) {
+            best_error = error;
+            best_len = sequence.size();
+        }
+    }
+
+    pruned.assign(num_nodes, false);
+    for (size_t k = 0; k < best_len; k++) {
+        pruned[sequence[k]] = true;
+    }
+    Compact(parent, pruned, tree);
+}
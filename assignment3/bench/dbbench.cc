@@ -0,0 +1,315 @@
+/**
+ * Benchmark of the phases of DBSCAN with synthetic data sets:
+ * index build, core detection, expansion, reorganization and output
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        dbbench.cc
+ */
+
+#include "DBSCAN.h"
+#include "pointfile.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <random>
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// clustering state of DBSCAN.cc
+extern PointSet g_points;
+extern string g_input_path;
+extern vector<struct object> g_objects;
+extern int g_num_cluster;
+
+struct {
+    const char *dataset = "blobs"; // blobs, uniform or rings
+    int num_points = 100000; // number of generated objects
+    int dims = 2; // number of coordinates of an object
+    int num_clusters = 10; // number of blobs or rings, also the expected number of clusters
+    double noise = 0.1; // fraction of the objects spread uniformly
+    double density = 4.0; // average number of objects per unit volume
+    double Eps = 1.0; // distance for finding neighbors
+    int MinPts = 10; // minimum number of neighbor points to be a core point
+    unsigned int seed = 1; // seed of the data and the start order
+    const char *index = "grid"; // spatial index, as passed to the clustering
+    int num_threads = 0; // threads, as passed to the clustering
+    const char *lazy = "off"; // lazy neighbor queries, as passed to the clustering
+    int tile_size = 0; // objects of a tile of the tiled clustering, as passed to the clustering
+} g_bench_config;
+
+/**
+ * Peak resident set size of the process in KB
+ */
+long PeakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Print one phase of the benchmark as a CSV row
+ *
+ * @param[in]   phase       name of the phase
+ * @param[in]   seconds     elapsed time
+ * @param[in]   items       number of processed objects
+ */
+void PrintPhase(const char *phase, double seconds, long items) {
+    printf("%s,%d,%d,%g,%d,%s,%d,%s,%d,%s,%.6f,%ld,%.1f,%ld\n",
+            g_bench_config.dataset, g_bench_config.num_points, g_bench_config.dims,
+            g_bench_config.Eps, g_bench_config.MinPts, g_bench_config.index,
+            g_bench_config.num_threads, g_bench_config.lazy, g_bench_config.tile_size,
+            phase, seconds, items, seconds > 0 ? items / seconds : 0.0, PeakRSS());
+    fflush(stdout);
+}
+
+double Elapsed(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+/**
+ * Generate the synthetic data set
+ * The objects are spread over a cube whose side keeps the average density constant,
+ * so the number of neighbors does not grow with the number of objects.
+ * The centers of the blobs and the rings are the centers of the cells of a lattice over the cube.
+ * blobs: gaussian blobs, with the noise fraction spread uniformly
+ * uniform: every object spread uniformly
+ * rings: rings over the first two dimensions, gaussian across the ring,
+ *        with the noise fraction spread uniformly
+ *
+ * @param[in]   rng         random source
+ * @param[out]  points      generated coordinates
+ * @return      whether the data set is known or not
+ */
+bool GenerateData(mt19937 &rng, PointSet &points) {
+    int num_points = g_bench_config.num_points;
+    int dims = g_bench_config.dims;
+    int num_clusters = g_bench_config.num_clusters;
+    bool blobs = strcmp(g_bench_config.dataset, "blobs") == 0;
+    bool rings = strcmp(g_bench_config.dataset, "rings") == 0;
+    if (blobs == false && rings == false && strcmp(g_bench_config.dataset, "uniform") != 0) {
+        return false;
+    }
+
+    // the side of the cube, the cells of the lattice and the size of a blob or a ring
+    double side = pow(num_points / g_bench_config.density, 1.0 / dims);
+    int cells = (int)ceil(pow(num_clusters, 1.0 / dims) - 1e-9);
+    double radius = side / cells / 4;
+    double width = radius / 8;
+    uniform_real_distribution<double> coord_dist(0.0, side);
+    uniform_real_distribution<double> unit_dist(0.0, 1.0);
+    uniform_int_distribution<int> cluster_dist(0, num_clusters - 1);
+    normal_distribution<double> blob_dist(0.0, radius / 2);
+    normal_distribution<double> ring_dist(0.0, width);
+    vector<double> centers((size_t)num_clusters * dims);
+    for (int c = 0; c < num_clusters; c++) {
+        int cell = c;
+        for (int d = 0; d < dims; d++) {
+            centers[(size_t)c * dims + d] = (cell % cells + 0.5) * side / cells;
+            cell /= cells;
+        }
+    }
+
+    points = PointSet();
+    points.dims = dims;
+    points.num_points = num_points;
+    points.coords.resize((size_t)dims * num_points);
+    double *coords = points.coords.data();
+    for (int i = 0; i < num_points; i++) {
+        if ((blobs == false && rings == false) || unit_dist(rng) < g_bench_config.noise) {
+            for (int d = 0; d < dims; d++) {
+                coords[(size_t)d * num_points + i] = coord_dist(rng);
+            }
+            continue;
+        }
+        const double *center = &centers[(size_t)cluster_dist(rng) * dims];
+        int d = 0;
+        if (rings && dims >= 2) {
+            double angle = 2 * M_PI * unit_dist(rng);
+            double distance = radius + ring_dist(rng);
+            coords[i] = center[0] + distance * cos(angle);
+            coords[(size_t)num_points + i] = center[1] + distance * sin(angle);
+            d = 2;
+        }
+        for (; d < dims; d++) {
+            coords[(size_t)d * num_points + i] = center[d] + (rings ? ring_dist(rng) : blob_dist(rng));
+        }
+    }
+    return true;
+}
+
+/**
+ * Time the tiled clustering of the data set streamed from a point file
+ * The data set is generated and saved by a child process, which keeps the points
+ * out of the peak RSS of the clustering.
+ *
+ * @param[in]   name    name of the data set, the point file is named after it
+ * @return      0
+ */
+int BenchTiles(const string &name) {
+    long size = g_bench_config.num_points;
+    g_input_path = "./data/output/" + name + "_points.bin";
+
+    auto begin = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        mt19937 rng(g_bench_config.seed);
+        bool saved = GenerateData(rng, g_points) && SavePoints(g_input_path.c_str(), g_points);
+        _exit(saved ? 0 : 1);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || WIFEXITED(status) == false || WEXITSTATUS(status) != 0) {
+        remove(g_input_path.c_str());
+        cout << "Can't generate the point file of " << g_bench_config.dataset << ". Program terminated." << endl;
+        return 0;
+    }
+    PrintPhase("generate", Elapsed(begin), size);
+
+    // partition, clustering of the tiles, reorganization and output
+    begin = chrono::steady_clock::now();
+    TiledClustering();
+    PrintPhase("tiled", Elapsed(begin), size);
+    remove(g_input_path.c_str());
+    fprintf(stderr, "clusters: %d found\n", g_num_cluster);
+    return 0;
+}
+
+/**
+ * @param[in]   command line arguments as below:
+ *              --dataset D       synthetic data set: blobs, uniform or rings
+ *              --points N        number of objects, e.g. 1e6
+ *              --dims N          number of coordinates of an object
+ *              --clusters N      number of blobs or rings, also the number of clusters
+ *              --noise P         fraction of the objects spread uniformly
+ *              --density R       average number of objects per unit volume
+ *              --eps E           Eps of the clustering
+ *              --min-pts N       MinPts of the clustering
+ *              --seed N          seed of the data and the start order
+ *              any other option is an option of the clustering, e.g. --index kdtree,
+ *              --threads N, --lazy on or --output labels. With --tile-size N the data set
+ *              is saved as a point file by a child process, so the peak RSS is the one of
+ *              the tiled clustering alone
+ * @return      0
+ */
+int main(int argc, const char *argv[]) {
+    vector<string> cluster_args;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--dataset") == 0) {
+            g_bench_config.dataset = argv[i + 1];
+        } else if (strcmp(argv[i], "--points") == 0) {
+            g_bench_config.num_points = (int)atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--dims") == 0) {
+            g_bench_config.dims = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--clusters") == 0) {
+            g_bench_config.num_clusters = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--noise") == 0) {
+            g_bench_config.noise = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--density") == 0) {
+            g_bench_config.density = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--eps") == 0) {
+            g_bench_config.Eps = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--min-pts") == 0) {
+            g_bench_config.MinPts = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            g_bench_config.seed = strtoul(argv[i + 1], NULL, 10);
+        } else {
+            // the options of the clustering are given to it, and the ones in the rows are kept
+            if (strcmp(argv[i], "--index") == 0) {
+                g_bench_config.index = argv[i + 1];
+            } else if (strcmp(argv[i], "--threads") == 0) {
+                g_bench_config.num_threads = atoi(argv[i + 1]);
+            } else if (strcmp(argv[i], "--lazy") == 0) {
+                g_bench_config.lazy = argv[i + 1];
+            } else if (strcmp(argv[i], "--tile-size") == 0) {
+                g_bench_config.tile_size = atoi(argv[i + 1]);
+            }
+            cluster_args.push_back(argv[i]);
+            cluster_args.push_back(argv[i + 1]);
+        }
+    }
+    if (argc % 2 == 0 || g_bench_config.num_points <= 0 || g_bench_config.dims <= 0
+            || g_bench_config.num_clusters <= 0 || g_bench_config.density <= 0) {
+        cout << "Invalid usage. Please check the arguments." << endl
+           << "$ [executable file] [--dataset blobs|uniform|rings] [--points N] [--dims N] "
+           << "[--clusters N] [--noise P] [--density R] [--eps E] [--min-pts N] [--seed N] "
+           << "[options of the clustering]" << endl;
+        return 0;
+    }
+
+    // the messages of the clustering go to stderr, so stdout is the CSV
+    cout.rdbuf(cerr.rdbuf());
+
+    // the output files are named after the data set
+    string name = string("dbbench_") + g_bench_config.dataset;
+    string num_clusters = to_string(g_bench_config.num_clusters);
+    string eps = to_string(g_bench_config.Eps);
+    string min_pts = to_string(g_bench_config.MinPts);
+    string seed = to_string(g_bench_config.seed);
+    vector<const char *> args = {argv[0], name.c_str(), num_clusters.c_str(), eps.c_str(), min_pts.c_str(),
+            "--seed", seed.c_str()};
+    for (auto &arg : cluster_args) {
+        args.push_back(arg.c_str());
+    }
+    if (InitCLA(args.size(), args.data()) == false) {
+        cout << "Invalid option of the clustering. Program terminated." << endl;
+        return 0;
+    }
+
+    printf("dataset,points,dims,eps,min_pts,index,threads,lazy,tile_size,phase,seconds,items,items_per_sec,peak_rss_kb\n");
+    long size = g_bench_config.num_points;
+    if (g_bench_config.tile_size > 0) {
+        return BenchTiles(name);
+    }
+
+    // generate the data set
+    mt19937 rng(g_bench_config.seed);
+    auto begin = chrono::steady_clock::now();
+    if (GenerateData(rng, g_points) == false) {
+        cout << "Unknown data set " << g_bench_config.dataset << ". Program terminated." << endl;
+        return 0;
+    }
+    InitObjectStates();
+    PrintPhase("generate", Elapsed(begin), size);
+
+    // the phases of DBSCAN(), timed one by one
+    begin = chrono::steady_clock::now();
+    BuildIndex();
+    PrintPhase("index", Elapsed(begin), size);
+
+    begin = chrono::steady_clock::now();
+    FindAllNeighbors();
+    FindAllCores();
+    PrintPhase("core", Elapsed(begin), size);
+
+    begin = chrono::steady_clock::now();
+    ExpandAllClusters();
+    ReleaseIndex();
+    PrintPhase("expand", Elapsed(begin), size);
+    int found_clusters = g_num_cluster;
+
+    begin = chrono::steady_clock::now();
+    ReorganizeCluster();
+    PrintPhase("reorganize", Elapsed(begin), size);
+
+    begin = chrono::steady_clock::now();
+    PrintOriginalObjects();
+    PrintCluster();
+    PrintPhase("output", Elapsed(begin), size);
+
+    // summary of the result, so that the clustering can be checked
+    long num_cores = 0;
+    long num_outliers = 0;
+    for (auto &obj : g_objects) {
+        num_cores += obj.is_core;
+        num_outliers += obj.type == ObjectType::OUTLIER;
+    }
+    fprintf(stderr, "clusters: %d found, %d after reorganization, cores: %ld, outliers: %ld\n",
+            found_clusters, g_num_cluster, num_cores, num_outliers);
+
+    return 0;
+}
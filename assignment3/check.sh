@@ -0,0 +1,27 @@
+# this shell script checks that a clustering extracted by --optics is the same as a run with its Eps
+BIN=$(cd ${BIN:-./bin/} && pwd)
+INPUT=$(pwd)/data/input
+WORK=$(mktemp -d)
+mkdir -p $WORK/data/output
+cd $WORK
+status=0
+check() {
+    # input, number of clusters, Eps of the ordering, Eps to extract, MinPts
+    $BIN/clustering $INPUT/$1.txt $2 $4 $5 --output labels > /dev/null
+    $BIN/clustering $INPUT/$1.txt $2 $3 $5 --optics $4 --output labels > /dev/null
+    if cmp -s ./data/output/$1_labels.txt ./data/output/$1_eps$4_labels.txt; then
+        echo "ok   $1 $2 $3 --optics $4 $5"
+    else
+        echo "FAIL $1 $2 $3 --optics $4 $5"
+        status=1
+    fi
+}
+check input1 8 15 15 22
+check input1 8 15 10 22
+check input1 1000 15 12.5 22
+check input2 5 2 2 7
+check input3 4 5 5 5
+check input3 1000 6 4 5
+check nd3 6 5 5 10
+cd / && rm -rf $WORK
+exit $status
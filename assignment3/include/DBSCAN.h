@@ -10,6 +10,8 @@
 #define __ASSIGNMENT3_INCLUDE_DBSCAN_H__
 
 #include <vector>
+#include <string>
+#include <algorithm>
 
 using namespace std;
 
@@ -20,30 +22,153 @@ enum class ObjectType {
     OUTLIER
 };
 
-struct object {
-    double x;
-    double y;
+class UnionFind;
+class Optics;
+class IncrementalDBSCAN;
+class BufferedWriter;
+
+/**
+ * Coordinates of all objects as structure of arrays
+ * Coordinates of a dimension are contiguous, coordinate d of the object i is
+ * Data()[d * Size() + i], so distance kernels read each dimension sequentially.
+ * The coordinates are either owned or mapped from a binary point file.
+ */
+struct PointSet {
+    int dims = 0; // number of dimensions
+    int num_points = 0;
+    vector<double> coords; // owned coordinates, empty if mapped
+    const double *mapped = nullptr; // coordinates in a mapped file
+
+    int Size() const { return num_points; }
+    const double *Data() const { return mapped != nullptr ? mapped : coords.data(); }
+    double At(int i, int d) const { return Data()[(size_t)d * num_points + i]; }
+    const double *Dim(int d) const { return Data() + (size_t)d * num_points; }
+
+    /**
+     * Copy the points in the given order
+     *
+     * @param[in]   order   object ids, the i-th one becomes the point i of the copy
+     */
+    PointSet Reorder(const vector<int> &order) const {
+        PointSet points;
+        points.dims = dims;
+        points.num_points = order.size();
+        points.coords.resize((size_t)dims * order.size());
+        for (int d = 0; d < dims; d++) {
+            const double *src = Dim(d);
+            double *dst = points.coords.data() + (size_t)d * points.num_points;
+            for (int i = 0; i < points.num_points; i++) {
+                dst[i] = src[order[i]];
+            }
+        }
+        return points;
+    }
 
+    /**
+     * Copy the coordinates in the given order, rounded to float
+     *
+     * @param[in]   order   object ids, the i-th one becomes the point i of the copy
+     * @return      coordinates of the copy in the layout of the points
+     */
+    vector<float> ReorderFloat(const vector<int> &order) const {
+        int size = order.size();
+        vector<float> coords_float((size_t)dims * size);
+        for (int d = 0; d < dims; d++) {
+            const double *src = Dim(d);
+            float *dst = coords_float.data() + (size_t)d * size;
+            for (int i = 0; i < size; i++) {
+                dst[i] = src[order[i]];
+            }
+        }
+        return coords_float;
+    }
+
+    /**
+     * Append the points of another set with the same number of dimensions
+     * The coordinates are copied into owned arrays, a mapped set is no longer used.
+     *
+     * @param[in]   points  points appended after the points of this set
+     */
+    void Append(const PointSet &points) {
+        Append(vector<const PointSet *>(1, &points));
+    }
+
+    /**
+     * Append the points of other sets with the same number of dimensions, one after another
+     * Every dimension is laid out again, so the sets are appended at once in a single copy.
+     *
+     * @param[in]   sets    points appended after the points of this set
+     */
+    void Append(const vector<const PointSet *> &sets) {
+        size_t size = num_points;
+        for (auto points : sets) {
+            if (size == 0) {
+                dims = points->dims;
+            }
+            size += points->num_points;
+        }
+        vector<double> merged((size_t)dims * size);
+        for (int d = 0; d < dims; d++) {
+            double *dst = merged.data() + (size_t)d * size;
+            dst = copy(Dim(d), Dim(d) + num_points, dst);
+            for (auto points : sets) {
+                dst = copy(points->Dim(d), points->Dim(d) + points->num_points, dst);
+            }
+        }
+        coords.swap(merged);
+        mapped = nullptr;
+        num_points = size;
+    }
+};
+
+struct object {
     ObjectType type;
     int cluster_num;
-    std::vector<int> neighbors;
+    bool is_core; // whether it has MinPts neighbors within Eps
+    std::vector<int> neighbors; // empty if the neighbors are queried lazily
 };
 
-void InitCLA(const char *argv[]);
+bool InitCLA(int argc, const char *argv[]);
+void RunClustering();
 void InitObject();
+void InitObjectStates();
 void ShuffleVector(vector<int> &v);
 void InitInputPath(const char *path);
 void PrintOriginalObjects();
+void PrintPoint(BufferedWriter &writer, int oid);
+void OpenOutput(BufferedWriter &writer, const string &path);
+void CloseOutput(BufferedWriter &writer);
 void DBSCAN();
+void ExpandAllClusters();
 void FindAllNeighbors();
+void BuildIndex();
+void ReleaseIndex();
+const PointSet &IndexedPoints();
 void FindAllCores();
 bool IsObjectRemained();
 int SelectStartObject();
 void MarkObjectVisted(int oid);
 bool IsCorePoint(object &o);
-void ExpandClusterDFS(object &center, int cluster_num);
-void ExpandClusterBFS(int center, int cluster_num);
+const vector<int> &GetNeighbors(int oid, vector<int> &buffer);
+void ExpandCluster(int center, int cluster_num);
+void CanonicalizeBorderPoints();
+void RenumberClusters();
+void LinkCorePoints(UnionFind &core_sets);
+void AssignBorderPoints(UnionFind &core_sets);
+void OPTICS();
+void PrintReachability(const Optics &optics);
+void IncrementalClustering();
+void InsertObjects(IncrementalDBSCAN &clusters, const PointSet &points, vector<int> &touched,
+        vector<pair<int, int>> &merged);
+void PrintBatchDelta(IncrementalDBSCAN &clusters, const vector<int> &touched, const vector<pair<int, int>> &merged);
+bool SplitList(const char *list, vector<string> &items);
+void TiledClustering();
+void PrintTiledLabels(const string &label_path, int size);
 void ReorganizeCluster();
+int MergeableClusters();
+vector<int> MergeClusters(const vector<int> &cluster_size, const PointSet &centroids);
 void PrintCluster();
+void PrintClusterFiles(const vector<int> &labels, int num_clusters);
+void PrintLabels(const vector<int> &labels);
     
 #endif // __ASSIGNMENT3_INCLUDE_DBSCAN_H__
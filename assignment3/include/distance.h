@@ -0,0 +1,96 @@
+/**
+ * Distance kernels testing a center against a block of points
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        distance.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_DISTANCE_H__
+#define __ASSIGNMENT3_INCLUDE_DISTANCE_H__
+
+#include "DBSCAN.h"
+
+enum class Metric {
+    EUCLIDEAN, // square root of the sum of the squared differences
+    MANHATTAN, // sum of the absolute differences
+    COSINE // 1 - cosine similarity, Euclidean distance of the normalized points
+};
+
+/**
+ * Write the ids of the points within Eps from the center
+ * Points are given as structure of arrays: coordinate d of the point i is block[d * stride + i],
+ * and coordinate d of the center is center[d * stride].
+ *
+ * @param[in]   center      first coordinate of the center
+ * @param[in]   block       first coordinate of the first point
+ * @param[in]   stride      distance between the arrays of two dimensions
+ * @param[in]   dims        number of dimensions
+ * @param[in]   ids         object ids of the points
+ * @param[in]   size        number of the points
+ * @param[in]   threshold   largest accumulated distance of a neighbor
+ * @param[out]  hits        ids of the points within Eps, room for size ids
+ * @return      number of the points within Eps
+ */
+typedef int (*ScanFunc)(const double *center, const double *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits);
+
+/**
+ * Count the points within Eps from the center
+ * The count may pass the limit by less than a block, callers clamp it
+ *
+ * @param[in]   center      first coordinate of the center
+ * @param[in]   block       first coordinate of the first point
+ * @param[in]   stride      distance between the arrays of two dimensions
+ * @param[in]   dims        number of dimensions
+ * @param[in]   size        number of the points
+ * @param[in]   threshold   largest accumulated distance of a neighbor
+ * @param[in]   limit       count to stop at
+ * @return      number of the points within Eps
+ */
+typedef int (*CountFunc)(const double *center, const double *block, int stride, int dims,
+        int size, double threshold, int limit);
+
+/**
+ * Kernels of ScanFunc and CountFunc over float coordinates, for the float32 mode
+ * The terms are computed and summed in float, and the threshold is rounded to float.
+ */
+typedef int (*ScanFloatFunc)(const float *center, const float *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits);
+typedef int (*CountFloatFunc)(const float *center, const float *block, int stride, int dims,
+        int size, double threshold, int limit);
+
+/**
+ * Accumulated distance between two points, summed as the kernels do
+ *
+ * @param[in]   a           first coordinate of a point
+ * @param[in]   b           first coordinate of the other point
+ * @param[in]   stride      distance between the arrays of two dimensions
+ * @param[in]   dims        number of dimensions
+ * @return      accumulated distance, compared with the threshold of a kernel
+ */
+typedef double (*DistanceFunc)(const double *a, const double *b, int stride, int dims);
+
+/**
+ * Kernels for a number of dimensions and a metric
+ */
+struct DistanceKernel {
+    const char *name; // instruction set of the kernels
+    ScanFunc scan;
+    CountFunc count;
+    ScanFloatFunc scan_float;
+    CountFloatFunc count_float;
+    DistanceFunc distance;
+    int dims; // number of dimensions
+    double threshold; // largest accumulated distance of a neighbor: Eps^2 or Eps
+    double radius; // largest difference of a coordinate between neighbors, for cells and pruning
+    bool single_precision; // indices store and scan the coordinates as float
+};
+
+DistanceKernel MakeDistanceKernel(int dims, Metric metric, double eps);
+bool SelectDistanceKernel(const char *name);
+void SelectPrecision(bool single);
+PointSet NormalizePoints(const PointSet &points);
+double MetricDistance(Metric metric, double accumulated);
+
+#endif // __ASSIGNMENT3_INCLUDE_DISTANCE_H__
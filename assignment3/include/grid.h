@@ -0,0 +1,63 @@
+/**
+ * Uniform grid index for the region query of DBSCAN
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        grid.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_GRID_H__
+#define __ASSIGNMENT3_INCLUDE_GRID_H__
+
+#include "spatialindex.h"
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * Objects are bucketed into square cells with the side of Eps over the first two dimensions,
+ * so that every neighbor of an object lies in the 3x3 cells around it.
+ * Cells are keyed by the Morton code of their column and row (the bits interleaved),
+ * and the objects are sorted by the key of their cell, so the objects follow the Z-order
+ * curve and the 3x3 cells around an object are a few nearby ranges of the sorted objects.
+ * Adjacent ranges are merged and tested against the center by the distance kernel at once.
+ * In the float32 mode, the grid is laid over the coordinates rounded to float and only
+ * the float copy is kept, so the kernels read half the bytes.
+ */
+class GridIndex : public SpatialIndex {
+public:
+    GridIndex(const PointSet &points, const DistanceKernel &kernel);
+
+    void RegionQuery(int oid, vector<int> &neighbors) const override;
+    int CountNeighbors(int oid, int limit) const override;
+    const vector<int> &Order() const override { return order_; }
+
+private:
+    DistanceKernel kernel_;
+    double side_; // side of a cell
+    double min_x_; // origin of the grid
+    double min_y_;
+    int64_t num_cols_; // number of cells of a row
+    int64_t num_rows_; // number of rows
+    bool morton_; // cells are keyed by the Morton code, otherwise row by row (over 2^32 columns or rows)
+    bool dense_; // every cell has its slot, otherwise the non-empty cells are found by binary search
+    vector<int> cell_slot_; // non-empty cell of each cell numbered row by row, -1 if empty (dense grid only)
+    vector<uint64_t> cell_keys_; // keys of the non-empty cells in ascending order (sparse grid only)
+    vector<int> cell_begin_; // offset of the first object of each non-empty cell in order_, and the end
+    vector<int> order_; // object ids sorted by their cell
+    vector<int> rank_; // position of each object in order_
+    PointSet sorted_; // coordinates in the order of order_, without coordinates in the float32 mode
+    vector<float> sorted_float_; // coordinates of sorted_ as float (float32 mode only)
+
+    int64_t Col(double x) const;
+    int64_t Row(double y) const;
+    double Round(double x) const;
+    double Coord(int pos, int d) const;
+    uint64_t CellKey(int64_t col, int64_t row) const;
+    void CellRange(int64_t col, int64_t row, int &begin, int &end) const;
+    template <typename Visit>
+    void Search(int oid, Visit visit) const;
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_GRID_H__
@@ -0,0 +1,70 @@
+/**
+ * Incremental DBSCAN keeping the clustering up to date while objects are inserted
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        incremental.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_INCREMENTAL_H__
+#define __ASSIGNMENT3_INCLUDE_INCREMENTAL_H__
+
+#include "DBSCAN.h"
+#include "distance.h"
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+using namespace std;
+
+#define INSERT_CHUNK (1 << 16) // objects inserted at once, bounds the neighbors kept while inserting
+
+/**
+ * Objects are kept in a hash grid with the cell side of Eps over the first two dimensions,
+ * which grows cell by cell as objects are inserted. Each object keeps the number of its
+ * neighbors, core points are linked with union-find (the root of a set is its smallest
+ * core point), and an object which is not core keeps its smallest core neighbor.
+ * Inserting a batch only queries the inserted objects and the objects which become core,
+ * and reports the objects and the sets it changed, so its cost depends on the density
+ * around the batch, not on the number of objects.
+ */
+class IncrementalDBSCAN {
+public:
+    IncrementalDBSCAN(const DistanceKernel &kernel, int min_pts);
+
+    void Insert(const PointSet &points, vector<int> &touched, vector<pair<int, int>> &merged);
+    int Label(vector<object> &objects);
+    ObjectType Type(int oid) const;
+    int Cluster(int oid);
+    int Size() const { return count_.size(); }
+
+private:
+    struct Cell {
+        vector<int> ids; // object ids in the cell
+        vector<double> coords; // coordinates of the objects, an object after another
+    };
+    struct CellHash {
+        size_t operator()(const pair<int64_t, int64_t> &key) const {
+            return (uint64_t)key.first * 0x9E3779B97F4A7C15ULL ^ (uint64_t)key.second;
+        }
+    };
+
+    DistanceKernel kernel_;
+    int min_pts_;
+    double side_; // side of a cell
+    unordered_map<pair<int64_t, int64_t>, int, CellHash> cell_of_key_; // cell of a column and a row
+    vector<Cell> cells_;
+    vector<double> coords_; // coordinates of every object, an object after another
+    vector<int> count_; // number of the neighbors, itself included
+    vector<int> parent_; // union-find over the core points
+    vector<int> first_core_; // smallest core neighbor of an object which is not core, -1 if none
+
+    bool IsCore(int oid) const { return count_[oid] >= min_pts_; }
+    pair<int64_t, int64_t> CellKey(const double *point) const;
+    void RegionQuery(int oid, vector<int> &neighbors) const;
+    int Find(int x);
+    void Union(int a, int b, vector<pair<int, int>> &merged);
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_INCREMENTAL_H__
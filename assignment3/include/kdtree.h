@@ -0,0 +1,58 @@
+/**
+ * k-d tree index for the region query of DBSCAN
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        kdtree.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_KD_TREE_H__
+#define __ASSIGNMENT3_INCLUDE_KD_TREE_H__
+
+#include "spatialindex.h"
+#include <vector>
+
+using namespace std;
+
+#define KD_LEAF_SIZE 16 // maximum number of objects of a leaf
+#define KD_MAX_DEPTH 64 // the tree of 2^31 objects is much shallower than this
+
+/**
+ * Balanced k-d tree bulk loaded by median split along the widest side
+ * Nodes are stored in an array and each node owns a contiguous range of the
+ * sorted objects, so a leaf is scanned sequentially.
+ * In the float32 mode, the splits are rounded to float and only the float copy is kept.
+ */
+class KDTreeIndex : public SpatialIndex {
+public:
+    KDTreeIndex(const PointSet &points, const DistanceKernel &kernel);
+
+    void RegionQuery(int oid, vector<int> &neighbors) const override;
+    int CountNeighbors(int oid, int limit) const override;
+    const vector<int> &Order() const override { return order_; }
+    int Nearest(const double *point) const;
+
+private:
+    struct Node {
+        int begin; // range of order_ owned by the node
+        int end;
+        int left; // children, -1 if the node is a leaf
+        int right;
+        int dim; // dimension of the split
+        double split; // the left has coordinates <= split, the right >= split
+    };
+
+    DistanceKernel kernel_;
+    vector<Node> nodes_; // root is the first one
+    vector<int> order_; // object ids sorted by the leaves
+    vector<int> rank_; // position of each object in order_
+    PointSet sorted_; // coordinates in the order of order_, without coordinates in the float32 mode
+    vector<float> sorted_float_; // coordinates of sorted_ as float (float32 mode only)
+
+    int Build(const PointSet &points, int begin, int end, int depth);
+    double Coord(int pos, int d) const;
+    template <typename Visit>
+    void Search(int oid, Visit visit) const;
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_KD_TREE_H__
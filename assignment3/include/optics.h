@@ -0,0 +1,55 @@
+/**
+ * OPTICS ordering of the objects, from which DBSCAN clusterings are extracted
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        optics.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_OPTICS_H__
+#define __ASSIGNMENT3_INCLUDE_OPTICS_H__
+
+#include "DBSCAN.h"
+#include "spatialindex.h"
+#include "distance.h"
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+/**
+ * Ordering points to identify the clustering structure (OPTICS)
+ * The objects are ordered once with the Eps of the spatial index, the generating distance.
+ * Each object keeps its core distance (distance to its MinPts-th nearest neighbor,
+ * itself included) and its reachability distance when it was ordered. Distances are
+ * accumulated distances of the kernel, so they are compared with kernel thresholds.
+ * For any Eps up to the generating distance, the DBSCAN clustering is extracted from
+ * the ordering in a pass over the objects without querying the index again.
+ */
+class Optics {
+public:
+    Optics(const PointSet &points, const SpatialIndex &index, const DistanceKernel &kernel, int min_pts);
+
+    void Run();
+    int Extract(double threshold, vector<object> &objects) const;
+
+    const vector<int> &Order() const { return order_; }
+    double CoreDistance(int oid) const { return core_dist_[oid]; }
+    double Reachability(int oid) const { return reach_[oid]; }
+
+private:
+    const PointSet &points_;
+    const SpatialIndex &index_;
+    DistanceKernel kernel_;
+    int min_pts_;
+    vector<int> order_; // object ids in the order of OPTICS
+    vector<double> core_dist_; // core distance, infinity if not core within the generating distance
+    vector<double> reach_; // reachability distance, infinity if reached from no core
+    // cores attaching each object, by increasing id and decreasing reachability distance
+    vector<vector<pair<int, double>>> attach_;
+
+    double Query(int oid, vector<int> &neighbors, vector<pair<double, int>> &dists) const;
+    void Attach(int oid, int core, double dist);
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_OPTICS_H__
@@ -0,0 +1,107 @@
+/**
+ * Parallel loop and lock-free union-find for the parallel DBSCAN
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        parallel.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_PARALLEL_H__
+#define __ASSIGNMENT3_INCLUDE_PARALLEL_H__
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+#define PARALLEL_CHUNK 1024 // number of items taken by a thread at once
+
+/**
+ * Run body(thread, i) for every i in [0, size) on num_threads threads
+ * Threads take chunks of items from a shared counter, so dense and sparse regions
+ * are balanced. The calling thread runs the loop by itself if num_threads <= 1.
+ *
+ * @param[in]   size            number of items
+ * @param[in]   num_threads     number of threads
+ * @param[in]   body            called with the thread number and the item
+ */
+template <typename Body>
+void ParallelFor(int size, int num_threads, Body body) {
+    if (num_threads <= 1) {
+        for (int i = 0; i < size; i++) {
+            body(0, i);
+        }
+        return;
+    }
+
+    atomic<int> next(0);
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.push_back(thread([&, t] {
+            int begin;
+            while ((begin = next.fetch_add(PARALLEL_CHUNK)) < size) {
+                int end = min(begin + PARALLEL_CHUNK, size);
+                for (int i = begin; i < end; i++) {
+                    body(t, i);
+                }
+            }
+        }));
+    }
+    for (auto &worker : threads) {
+        worker.join();
+    }
+}
+
+/**
+ * Disjoint sets of objects which can be united by several threads at once
+ * The root of a set is always its smallest element, since a root is only
+ * linked to a smaller root, and the link is made by compare-and-swap.
+ * Find compresses the path by halving, also with compare-and-swap.
+ */
+class UnionFind {
+public:
+    explicit UnionFind(int size) : parent_(size) {
+        for (int i = 0; i < size; i++) {
+            parent_[i].store(i, memory_order_relaxed);
+        }
+    }
+
+    int Find(int x) {
+        while (true) {
+            int parent = parent_[x].load(memory_order_relaxed);
+            if (parent == x) {
+                return x;
+            }
+            int grandparent = parent_[parent].load(memory_order_relaxed);
+            if (parent != grandparent) {
+                parent_[x].compare_exchange_weak(parent, grandparent, memory_order_relaxed);
+            }
+            x = grandparent;
+        }
+    }
+
+    void Union(int a, int b) {
+        while (true) {
+            a = Find(a);
+            b = Find(b);
+            if (a == b) {
+                return;
+            }
+            if (a < b) {
+                swap(a, b);
+            }
+            // link the larger root to the smaller one, retry if a was linked meanwhile
+            int expected = a;
+            if (parent_[a].compare_exchange_strong(expected, b, memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+private:
+    vector<atomic<int>> parent_;
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_PARALLEL_H__
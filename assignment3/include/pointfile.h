@@ -0,0 +1,77 @@
+/**
+ * Loading the input points from a text or binary point file
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        pointfile.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_POINT_FILE_H__
+#define __ASSIGNMENT3_INCLUDE_POINT_FILE_H__
+
+#include "DBSCAN.h"
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+#define POINT_MAGIC "DBPOINT"
+#define POINT_VERSION 1
+
+/**
+ * Layout of the binary point file
+ *  - PointHeader
+ *  - coordinates as doubles, dimension by dimension: coordinate d of the point i
+ *    is at coord_offset + (d * num_points + i) * 8, the layout of PointSet
+ */
+struct PointHeader {
+    char magic[8]; // POINT_MAGIC
+    uint32_t version; // POINT_VERSION
+    uint32_t dims; // number of dimensions
+    uint64_t num_points; // number of points
+    uint64_t coord_offset; // offset of the coordinates, aligned to 8 bytes
+    uint64_t file_size; // size of the whole file
+};
+
+/**
+ * Input file mapped into memory
+ * A text file is parsed into the point set and unmapped. The coordinates of a binary
+ * file are used in place, so the file has to stay mapped while the points are used.
+ * A file can also be read chunk by chunk with Open and Next, which keeps no more
+ * than a chunk of the points in memory and releases the mapped pages already read.
+ */
+class PointFile {
+public:
+    PointFile() : addr_(NULL), size_(0), binary_(false), dims_(0), cursor_(0), line_(0) {}
+    ~PointFile();
+
+    bool Load(const char *path, PointSet &points, int num_threads);
+    bool Open(const char *path);
+    bool Next(PointSet &points);
+    int Dims() const { return dims_; }
+    const string &Error() const { return error_; }
+
+private:
+    void *addr_; // mapped address
+    size_t size_; // mapped size
+    bool binary_; // whether the mapped file is a binary point file
+    string error_; // reason of the failure
+    int dims_; // number of coordinates of the opened file
+    PointSet stream_; // points of the opened binary file
+    size_t cursor_; // next byte of the opened text file or next point of the opened binary file
+    long line_; // lines of the opened text file read so far
+
+    bool Map(const char *path);
+    bool LoadText(PointSet &points, int num_threads);
+    bool LoadBinary(PointSet &points);
+    void Release(const void *begin, const void *end) const;
+    void Unmap();
+
+    PointFile(const PointFile &);
+    PointFile &operator=(const PointFile &);
+};
+
+bool SavePoints(const char *path, const PointSet &points);
+
+#endif // __ASSIGNMENT3_INCLUDE_POINT_FILE_H__
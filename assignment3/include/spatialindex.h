@@ -0,0 +1,114 @@
+/**
+ * Spatial index for the region query of DBSCAN
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        spatialindex.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_SPATIAL_INDEX_H__
+#define __ASSIGNMENT3_INCLUDE_SPATIAL_INDEX_H__
+
+#include "DBSCAN.h"
+#include "distance.h"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+enum class IndexType {
+    BRUTE_FORCE, // compare with every object, reference for validation
+    GRID, // uniform grid with the cell side of Eps
+    KD_TREE // k-d tree with buckets of objects as leaves
+};
+
+/**
+ * Retrieve the reachable objects(neighbors) of an object
+ * Reachable: distance between two objects is less than or equal to Eps
+ */
+class SpatialIndex {
+public:
+    virtual ~SpatialIndex() {}
+
+    /**
+     * Retrieve all objects within Eps from the object (the object itself included)
+     *
+     * @param[in]   oid         object id of the center
+     * @param[out]  neighbors   object ids of the neighbors
+     */
+    virtual void RegionQuery(int oid, vector<int> &neighbors) const = 0;
+
+    /**
+     * Count the objects within Eps from the object (the object itself included)
+     * The search stops as soon as the count reaches the limit, so checking a core point
+     * costs MinPts distance tests in a dense region and stores no neighbor
+     *
+     * @param[in]   oid         object id of the center
+     * @param[in]   limit       count to stop at
+     * @return      number of the neighbors, at most limit
+     */
+    virtual int CountNeighbors(int oid, int limit) const = 0;
+
+    /**
+     * Object ids in the order the coordinates are stored by the index
+     * Querying the objects in this order reads nearby coordinates one after another.
+     *
+     * @return      object ids in the stored order
+     */
+    virtual const vector<int> &Order() const = 0;
+};
+
+/**
+ * Compare the center with every object, O(n) per query
+ * In the float32 mode, the objects are compared by a float copy of the coordinates.
+ */
+class BruteForceIndex : public SpatialIndex {
+public:
+    BruteForceIndex(const PointSet &points, const DistanceKernel &kernel)
+    : points_(points), kernel_(kernel), ids_(points.Size()) {
+        for (int i = 0; i < points.Size(); i++) {
+            ids_[i] = i;
+        }
+        if (kernel.single_precision) {
+            coords_float_.assign(points.Data(), points.Data() + (size_t)points.dims * points.Size());
+        }
+    }
+
+    void RegionQuery(int oid, vector<int> &neighbors) const override {
+        int size = points_.Size();
+        neighbors.resize(size);
+        if (kernel_.single_precision) {
+            neighbors.resize(kernel_.scan_float(&coords_float_[oid], coords_float_.data(), size, points_.dims,
+                    ids_.data(), size, kernel_.threshold, neighbors.data()));
+            return;
+        }
+        neighbors.resize(kernel_.scan(points_.Dim(0) + oid, points_.Dim(0), size, points_.dims,
+                ids_.data(), size, kernel_.threshold, neighbors.data()));
+    }
+
+    int CountNeighbors(int oid, int limit) const override {
+        if (limit <= 0) {
+            return 0;
+        }
+        int size = points_.Size();
+        int count;
+        if (kernel_.single_precision) {
+            count = kernel_.count_float(&coords_float_[oid], coords_float_.data(), size, points_.dims,
+                    size, kernel_.threshold, limit);
+        } else {
+            count = kernel_.count(points_.Dim(0) + oid, points_.Dim(0), size, points_.dims,
+                    size, kernel_.threshold, limit);
+        }
+        return min(count, limit);
+    }
+
+    const vector<int> &Order() const override { return ids_; }
+
+private:
+    const PointSet &points_;
+    DistanceKernel kernel_;
+    vector<int> ids_; // object ids in the order of the coordinates, the identity
+    vector<float> coords_float_; // coordinates rounded to float (float32 mode only)
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_SPATIAL_INDEX_H__
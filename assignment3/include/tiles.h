@@ -0,0 +1,124 @@
+/**
+ * Out-of-core DBSCAN clustering the objects tile by tile
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        tiles.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_TILES_H__
+#define __ASSIGNMENT3_INCLUDE_TILES_H__
+
+#include "DBSCAN.h"
+#include "spatialindex.h"
+#include "distance.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+#define TILE_BINS (1 << 18) // bins of the histogram placing the tiles, shared by the split dimensions
+#define TILE_MIN_SIDE 2 // a tile is not split into sides narrower than this many halos
+#define TILE_MARGIN 1e-9 // relative margin of the halo for the rounding of distances
+#define TILE_READ_RECORDS (1 << 14) // records of a tile or result file read at once
+
+/**
+ * Result of an object written by a tile, in the tile result file and the label file
+ */
+struct TileLabel {
+    int32_t oid; // object id
+    int32_t cluster; // cluster of the object, -1 for outliers
+    int32_t type; // ObjectType
+};
+
+/**
+ * Rectangle of a tile over the first two dimensions (only the first for 1-dimensional data)
+ * The tile owns the objects with lo[d] <= x[d] < hi[d].
+ */
+struct TileRect {
+    double lo[2];
+    double hi[2];
+};
+
+/**
+ * Node of the tree splitting the data space into tiles
+ */
+struct TileNode {
+    int dim; // dimension split, -1 for a tile
+    double split; // objects below it go to the left child
+    int left; // left child, or the tile of a leaf
+    int right; // right child
+};
+
+/**
+ * DBSCAN over the input streamed from the disk, holding a tile of objects at a time
+ * 1. Partition: the input is read chunk by chunk, and the data space is split over the
+ *    first two dimensions into rectangles owning about tile_size objects each, like a k-d tree
+ *    built over a histogram. Each object is written to the file of every tile whose halo
+ *    covers it. The halo is twice Eps wide, so the core points are exact within Eps of the tile.
+ *    A tile loads its objects and the band around it, which is small next to a tile much
+ *    wider than Eps. A side is not split narrower than TILE_MIN_SIDE halos, which bounds the
+ *    copies of an object when the objects within Eps outnumber the tile size.
+ * 2. Cluster: each tile is loaded and clustered with a spatial index on its own.
+ *    The cores within Eps of the tile are linked with union-find into local clusters,
+ *    and a border point joins the local cluster of its smallest core neighbor.
+ *    A core point near a boundary is in the local clusters of both tiles, so the local
+ *    clusters sharing a core point are merged into one cluster.
+ * 3. Label: the results of the tiles are split into files of about tile_size object ids each,
+ *    and each of them is loaded and written to the label file in the order of the object ids.
+ * Clusters are numbered by their smallest member, the same as the in-memory clustering.
+ */
+class TiledDBSCAN {
+public:
+    TiledDBSCAN(Metric metric, double eps, int min_pts, IndexType index, int tile_size, const string &work_path);
+    ~TiledDBSCAN();
+
+    bool Partition(const char *path);
+    bool Cluster();
+    bool Label(const vector<int> &label_of_cluster, const string &path);
+
+    int Size() const { return num_points_; }
+    int NumTiles() const { return tiles_.size(); }
+    int NumClusters() const { return cluster_size_.size(); }
+    const vector<int> &ClusterSizes() const { return cluster_size_; }
+    PointSet Centroids() const;
+    const string &Error() const { return error_; }
+
+private:
+    Metric metric_;
+    double eps_;
+    int min_pts_;
+    IndexType index_;
+    int tile_size_; // objects owned by a tile
+    string work_path_; // prefix of the tile files
+    DistanceKernel kernel_;
+    double halo_; // width of the ring where the core points are exact
+    int dims_;
+    int split_dims_; // dimensions the tiles are split on, the first two at most
+    int num_points_;
+    vector<TileRect> tiles_; // rectangle of each tile
+    vector<TileNode> nodes_; // tree of the splits, the root first
+    vector<int> cluster_of_node_; // cluster of each local cluster of the tiles
+    vector<int> cluster_size_; // objects of each cluster
+    vector<double> cluster_sums_; // sum of the coordinates of each cluster, dims_ per cluster
+    string error_;
+
+    string TilePath(int tile) const;
+    string ResultPath(int tile) const;
+    string RangePath(int range) const;
+    int NumRanges() const { return (num_points_ + tile_size_ - 1) / tile_size_; }
+    size_t BufferSize(size_t record) const;
+    void RemoveFiles() const;
+    int SplitTiles(const vector<long> &table, const int *bins, const double *min_x, const double *width,
+            int *lo, int *hi);
+    void TilesNear(int node, const double *x, double margin, vector<int> &tiles) const;
+    SpatialIndex *BuildIndex(const PointSet &points) const;
+    bool ClusterTile(int tile, vector<pair<int, int>> &ring_cores, vector<pair<int, int>> &edge_cores,
+            vector<int> &node_min_oid, vector<int> &node_size, vector<double> &node_sums);
+
+    TiledDBSCAN(const TiledDBSCAN &);
+    TiledDBSCAN &operator=(const TiledDBSCAN &);
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_TILES_H__
@@ -0,0 +1,61 @@
+/**
+ * Buffered writer of the output files
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        writer.h
+ */
+
+#ifndef __ASSIGNMENT3_INCLUDE_WRITER_H__
+#define __ASSIGNMENT3_INCLUDE_WRITER_H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define WRITER_BUFFER_SIZE (1 << 20) // bytes written to the file at once
+#define WRITER_MIN_BUFFER_SIZE 64 // smallest buffer, room for any number
+
+enum class OutputMode {
+    CLUSTERS, // coordinates and object ids of each cluster, 2 text files per cluster
+    LABELS, // a text file of object id, cluster and type per line
+    BINARY // a binary file of the cluster of each object as int32, -1 for outliers
+};
+
+/**
+ * Output file written in large blocks
+ * Text is formatted into the buffer, and the buffer is written when it is full
+ */
+class BufferedWriter {
+public:
+    BufferedWriter() : used_(0) {}
+    ~BufferedWriter() { Close(); }
+
+    bool Open(const string &path, size_t buffer_size = WRITER_BUFFER_SIZE);
+    bool Close();
+
+    void Write(const char *data, size_t size);
+    void WriteChar(char c) {
+        if (used_ == buffer_.size()) {
+            Flush();
+        }
+        buffer_[used_++] = c;
+    }
+    void WriteInt(long value);
+    void WriteDouble(double value);
+
+private:
+    ofstream fs_;
+    vector<char> buffer_;
+    size_t used_; // bytes in the buffer
+
+    void Flush();
+    void Reserve(size_t size);
+
+    BufferedWriter(const BufferedWriter &);
+    BufferedWriter &operator=(const BufferedWriter &);
+};
+
+#endif // __ASSIGNMENT3_INCLUDE_WRITER_H__
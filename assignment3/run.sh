@@ -2,4 +2,9 @@
 ./bin/clustering ./data/input/input1.txt 8 15 22 
 ./bin/clustering ./data/input/input2.txt 5 2 7
 ./bin/clustering ./data/input/input3.txt 4 5 5
+# N-dimensional sample inputs, 1, 3, 5 and 8 coordinates per object
+./bin/clustering ./data/input/nd1.txt 3 2 10 --output labels
+./bin/clustering ./data/input/nd3.txt 6 5 10 --output labels
+./bin/clustering ./data/input/nd5.txt 6 6 10 --output labels
+./bin/clustering ./data/input/nd8.txt 6 10 10 --output labels
 gnuplot plot.gp
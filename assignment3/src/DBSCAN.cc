@@ -7,103 +7,237 @@
  */
 
 #include "DBSCAN.h"
+#include "spatialindex.h"
+#include "grid.h"
+#include "kdtree.h"
+#include "parallel.h"
+#include "distance.h"
+#include "pointfile.h"
+#include "writer.h"
+#include "optics.h"
+#include "incremental.h"
+#include "tiles.h"
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <string>
-#include <queue>
 #include <cmath>
 #include <climits>
+#include <queue>
 #include <ctime>
+#include <random>
 
-fstream  g_fs_input; // input file stream
-ofstream g_fs_output; // output file stream
+string g_input_path; // input file path
+PointFile g_point_file; // mapped input file
+BufferedWriter g_fs_output; // output file writer
 string g_input_file_name; // input file name
 int g_num_cluster; // number of cluster that has been formed
 vector<struct object> g_objects; // all input objects
-vector<int> g_unvisited_objs; // unvisited objects
+PointSet g_points; // coordinates of all input objects
+PointSet g_normalized_points; // unit length coordinates for the cosine metric
+vector<int> g_start_order; // shuffled object ids for picking start points
+size_t g_start_cursor; // first position of g_start_order not examined yet
+vector<bool> g_visited; // visited bitmap, one bit per object
 vector<bool> g_valid_clusters; // valid clusters for reorganization
+SpatialIndex *g_index; // spatial index for finding neighbors
+vector<int> g_frontier; // core points to be expanded, reused across clusters
+vector<int> g_neighbor_buffer; // neighbors queried lazily, reused across queries
 
 struct {
     int num_clusters; // expected number of clusters
-    int Eps; // distance for finding neighbors
+    double Eps; // distance for finding neighbors
     int MinPts; // minimum number of neighbor points to be a core point
+    IndexType index = IndexType::GRID; // spatial index for finding neighbors
+    Metric metric = Metric::EUCLIDEAN; // distance between two objects
+    bool lazy = false; // query the neighbors during expansion instead of storing them
+    int num_threads = 0; // threads of the parallel union-find clustering, 0 means serial expansion
+    const char *save_points = NULL; // path to save the input as a binary point file
+    OutputMode output = OutputMode::CLUSTERS; // files of the clustering result
+    vector<string> extract_eps; // Eps of each clustering extracted from the OPTICS ordering, as given
+    vector<string> insert_paths; // batch files inserted one after another by the incremental DBSCAN
+    int tile_size = 0; // objects of a tile in the out-of-core clustering, 0 means in memory
+    long seed = -1; // seed of the start order, -1 means the current time
+    bool single_precision = false; // indices store and scan the coordinates as float
 } g_cluster_config; 
 
 /**
- * Calculate the distance between two input objects
- *
- * @param[in]   object a, b
- * @return      distance
- */
-inline double Distance(object &a, object &b) {
-    return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
-}
-
-/**
- * Determine if the target object is reachable from ceneter object 
- * Reachable decision: distance between center and target object is less than or equal to epsilon
- *
- * @param[in]   center, target object
- * @return      whether reachable or not
+ * Run the clustering selected by the configuration
+ * The input is loaded first, except for the tiled clustering which streams it from the disk.
  */
-inline bool IsReachable(object &center, object &target) {
-    return Distance(center, target) <= g_cluster_config.Eps; 
-}
-
-/**
- * @param[in]   command line arguments as below:
- *              argv[0] executable file
- *              argv[1] input data file
- *              argv[2] n: number of clusters
- *              argv[3] Eps: maximum radius of the neighborhood
- *              argv[4] MinPts: minimum number of points 
- *                              in an Eps-neighborhood of a given point
- * @return      0
- */
-int main(int argc, const char *argv[]) {
-    if (argc == 5) {
-        InitCLA(argv);
-        InitObject();
-        PrintOriginalObjects();
+void RunClustering() {
+    if (g_cluster_config.tile_size > 0) {
+        // the input is streamed from the disk instead of being loaded
+        TiledClustering();
+        return;
+    }
+    InitObject();
+    PrintOriginalObjects();
+    if (g_cluster_config.extract_eps.empty() == false) {
+        OPTICS();
+    } else if (g_cluster_config.insert_paths.empty() == false) {
+        IncrementalClustering();
+    } else {
         DBSCAN();
         ReorganizeCluster();
         PrintCluster();
-    } else {
-        cout << "Invalid usage. Please check the arguments." << endl
-           << "$ [executable file] [input data file] [number of clusters] [Eps] [MinPts]" << endl;
     }
-
-    return 0;
 }
 
 /**
  * Open in/out file with Command Line Arguments
  * Configuration setup
  *
+ * @param[in]   argc   number of command line arguments
  * @param[in]   argv   input command line arguments 
+ * @return      whether the usage is valid or not
  */
-void InitCLA(const char *argv[]) {
-    // open input data file
-    g_fs_input.open(argv[1], ifstream::in);
-    if (g_fs_input.is_open() == false) {
-        cout << "Can't open input data file. Program terminated." << endl;
-        exit(0);
+bool InitCLA(int argc, const char *argv[]) {
+    vector<const char *> args;
+
+    // setup the option value
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            args.push_back(argv[i]);
+            continue;
+        } else if (i + 1 >= argc) {
+            return false;
+        }
+
+        if (strcmp(argv[i], "--index") == 0) {
+            if (strcmp(argv[i + 1], "grid") == 0) {
+                g_cluster_config.index = IndexType::GRID;
+            } else if (strcmp(argv[i + 1], "kdtree") == 0) {
+                g_cluster_config.index = IndexType::KD_TREE;
+            } else if (strcmp(argv[i + 1], "brute") == 0) {
+                g_cluster_config.index = IndexType::BRUTE_FORCE;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--lazy") == 0) {
+            if (strcmp(argv[i + 1], "on") == 0) {
+                g_cluster_config.lazy = true;
+            } else if (strcmp(argv[i + 1], "off") == 0) {
+                g_cluster_config.lazy = false;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            g_cluster_config.num_threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--metric") == 0) {
+            if (strcmp(argv[i + 1], "euclidean") == 0) {
+                g_cluster_config.metric = Metric::EUCLIDEAN;
+            } else if (strcmp(argv[i + 1], "manhattan") == 0) {
+                g_cluster_config.metric = Metric::MANHATTAN;
+            } else if (strcmp(argv[i + 1], "cosine") == 0) {
+                g_cluster_config.metric = Metric::COSINE;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--output") == 0) {
+            if (strcmp(argv[i + 1], "clusters") == 0) {
+                g_cluster_config.output = OutputMode::CLUSTERS;
+            } else if (strcmp(argv[i + 1], "labels") == 0) {
+                g_cluster_config.output = OutputMode::LABELS;
+            } else if (strcmp(argv[i + 1], "binary") == 0) {
+                g_cluster_config.output = OutputMode::BINARY;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--save-points") == 0) {
+            g_cluster_config.save_points = argv[i + 1];
+        } else if (strcmp(argv[i], "--optics") == 0) {
+            if (SplitList(argv[i + 1], g_cluster_config.extract_eps) == false) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--precision") == 0) {
+            if (strcmp(argv[i + 1], "double") == 0) {
+                g_cluster_config.single_precision = false;
+            } else if (strcmp(argv[i + 1], "float") == 0) {
+                g_cluster_config.single_precision = true;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            g_cluster_config.seed = atol(argv[i + 1]);
+        } else if (strcmp(argv[i], "--tile-size") == 0) {
+            g_cluster_config.tile_size = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--insert") == 0) {
+            if (SplitList(argv[i + 1], g_cluster_config.insert_paths) == false) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--simd") == 0) {
+            if (SelectDistanceKernel(argv[i + 1]) == false) {
+                cout << "Distance kernel " << argv[i + 1] << " is not supported. Program terminated." << endl;
+                exit(0);
+            }
+        } else {
+            cout << "Unknown option " << argv[i] << ". Program terminated." << endl;
+            exit(0);
+        }
+        i++;
+    }
+    if (args.size() != 4) {
+        return false;
     }
 
-    // initialize input file name from path
-    InitInputPath(argv[1]);
+    // initialize input file name from path, the file is loaded by InitObject
+    g_input_path = args[0];
+    InitInputPath(args[0]);
 
     // setup the configuration value
-    g_cluster_config.num_clusters = atoi(argv[2]);
-    g_cluster_config.Eps = atoi(argv[3]);
-    g_cluster_config.MinPts = atoi(argv[4]);
+    g_cluster_config.num_clusters = atoi(args[1]);
+    g_cluster_config.Eps = atof(args[2]);
+    g_cluster_config.MinPts = atoi(args[3]);
+    for (auto &eps : g_cluster_config.extract_eps) {
+        if (atof(eps.c_str()) > g_cluster_config.Eps) {
+            cout << "Extracted Eps " << eps << " is larger than Eps. Program terminated." << endl;
+            exit(0);
+        }
+    }
+    // OPTICS and the incremental DBSCAN measure the distances in double by themselves
+    if (g_cluster_config.single_precision
+            && (g_cluster_config.extract_eps.empty() == false || g_cluster_config.insert_paths.empty() == false)) {
+        cout << "Float coordinates are not supported with --optics and --insert. Program terminated." << endl;
+        exit(0);
+    }
+    // the tiled clustering streams the input and clusters a tile at a time on a single thread
+    if (g_cluster_config.tile_size > 0
+            && (g_cluster_config.extract_eps.empty() == false || g_cluster_config.insert_paths.empty() == false
+                || g_cluster_config.save_points != NULL || g_cluster_config.num_threads > 0)) {
+        cout << "Tiled clustering is not supported with --optics, --insert, --save-points and --threads. "
+             << "Program terminated." << endl;
+        exit(0);
+    }
+    SelectPrecision(g_cluster_config.single_precision);
 
-    cout << "input file path: " << argv[1] << " ";
+    cout << "input file path: " << args[0] << " ";
     cout << "num_clusters: " << g_cluster_config.num_clusters << " ";
     cout << "Eps: " << g_cluster_config.Eps << " ";
     cout << "MinPts: " << g_cluster_config.MinPts << endl;
+    return true;
+}
+
+/**
+ * Split a comma separated list of an option
+ *
+ * @param[in]   list    option value
+ * @param[out]  items   items of the list appended
+ * @return      whether every item is not empty or not
+ */
+bool SplitList(const char *list, vector<string> &items) {
+    string value = list;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = min(value.find(',', begin), value.size());
+        if (end == begin) {
+            return false;
+        }
+        items.push_back(value.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return true;
 }
 
 /**
@@ -127,60 +261,115 @@ void InitInputPath(const char *path) { size_t pos;
 }
 
 /**
- * Initialize the objects' x, y coordinate information from input file
- *
- * @param[in]   path  path of input file 
+ * Initialize the objects' coordinates from input file
+ * A text file is mapped and parsed in place, a binary point file is used in place.
  */
 void InitObject() {
-    int oid;
+    if (g_point_file.Load(g_input_path.c_str(), g_points, g_cluster_config.num_threads) == false) {
+        cout << g_point_file.Error() << " Program terminated." << endl;
+        exit(0);
+    }
+    if (g_cluster_config.save_points != NULL && SavePoints(g_cluster_config.save_points, g_points) == false) {
+        cout << "Can't save the point file. Program terminated." << endl;
+        exit(0);
+    }
+    InitObjectStates();
+}
+
+/**
+ * Initialize every object of the points unclassified and shuffle the start order
+ */
+void InitObjectStates() {
     object input_object;
     input_object.type = ObjectType::NOT_DEFINED;
-
-    // get the object data from the input file
-    while(g_fs_input >> oid) {
-        g_fs_input >> input_object.x >> input_object.y;
-        g_unvisited_objs.push_back(oid);
-        g_objects.push_back(input_object);
+    input_object.cluster_num = -1;
+    input_object.is_core = false;
+    g_objects.assign(g_points.Size(), input_object);
+    g_start_order.resize(g_points.Size());
+    for (int i = 0; i < g_points.Size(); i++) {
+        g_start_order[i] = i;
     }
 
-    // shuffle the unvisited object vector
-    ShuffleVector(g_unvisited_objs);
-    g_fs_input.close();
+    // shuffle the start order, every object is unvisited at first
+    ShuffleVector(g_start_order);
+    g_start_cursor = 0;
+    g_visited.assign(g_objects.size(), false);
 }
 
 /**
- * Shulffle the unvisited object vector for start point random pick
+ * Shulffle the start order for start point random pick
+ * The Mersenne Twister is seeded by the configuration, and its 32-bit outputs are scaled
+ * to the range by a multiplication, so a seed gives the same order on every platform.
  *
- * @param[in]   unvisited object vector
+ * @param[in]   object id vector
  */
 void ShuffleVector(vector<int> &v) {
-    srand(time(NULL));
+    mt19937 random(g_cluster_config.seed < 0 ? time(NULL) : g_cluster_config.seed);
     int size = v.size();
     int rnd_idx;
     int tmp;
     for (int i = size - 1; i > 0; i--) {
-        rnd_idx = rand() % (i + 1);
+        rnd_idx = ((uint64_t)random() * (i + 1)) >> 32;
         tmp = v[rnd_idx];
         v[rnd_idx] = v[i];
         v[i] = tmp;
     }
 }
 
+/**
+ * Open an output file or terminate the program
+ *
+ * @param[out]  writer  writer of the file
+ * @param[in]   path    path of the output file
+ */
+void OpenOutput(BufferedWriter &writer, const string &path) {
+    if (writer.Open(path) == false) {
+        cout << "Can't open output data file. Program terminated." << endl;
+        exit(0);
+    }
+}
+
+/**
+ * Close an output file or terminate the program if it was not fully written
+ *
+ * @param[in]   writer  writer of the file
+ */
+void CloseOutput(BufferedWriter &writer) {
+    if (writer.Close() == false) {
+        cout << "Can't write output data file. Program terminated." << endl;
+        exit(0);
+    }
+}
+
 /**
  * Print the original objects to output file path before clustering 
+ * Only the cluster files output has it
  */
 void PrintOriginalObjects() {
+    if (g_cluster_config.output != OutputMode::CLUSTERS) {
+        return;
+    }
     string path_base = "./data/output/";
-    string path = path_base + g_input_file_name + "_original.txt";
-    g_fs_output.open(path, ifstream::out);
-    if (g_fs_output.is_open() == false) {
-        cout << "Can't open output data file. Program terminated." << endl;
-        exit(0);
+    OpenOutput(g_fs_output, path_base + g_input_file_name + "_original.txt");
+    int size = g_points.Size();
+    for (int i = 0; i < size; i++) {
+        PrintPoint(g_fs_output, i);
     }
-    for (auto obj : g_objects) {
-        g_fs_output << obj.x << "\t" << obj.y << "\t" << endl;
+    CloseOutput(g_fs_output);
+}
+
+/**
+ * Print the coordinates of an object as a line, each followed by a tab
+ *
+ * @param[in]   writer  output file
+ * @param[in]   oid     object id
+ */
+void PrintPoint(BufferedWriter &writer, int oid) {
+    for (int d = 0; d < g_points.dims; d++) {
+        writer.WriteDouble(g_points.At(oid, d));
+        writer.WriteChar('\t');
     }
-    g_fs_output.close();
+    writer.WriteChar('\n');
 }
 
 /**
@@ -193,90 +382,167 @@ void PrintOriginalObjects() {
  */
 void DBSCAN() {
     // retrieve all reachable points from point p w.r.t Eps
+    BuildIndex();
     FindAllNeighbors();
     // find all core points with point's number of neighbors
     FindAllCores();
-    while(IsObjectRemained()) {
-        // select a start point p randomly
-        int p = SelectStartObject();
-
-        // if the point is core, expand the cluster
-        if(IsCorePoint(g_objects[p])) {
-            g_objects[p].type = ObjectType::CORE;
-            g_objects[p].cluster_num = g_num_cluster;
-            ExpandClusterDFS(g_objects[p], g_num_cluster++);
-            // ExpandClusterBFS(p, g_num_cluster++);
-        } else {
-            // if not, mark as outlier
-            g_objects[p].type = ObjectType::OUTLIER;
+    ExpandAllClusters();
+    ReleaseIndex();
+}
+
+/**
+ * Form the clusters from the core points found by FindAllCores
+ * The clusters are expanded from the start points one by one, or the core points are
+ * linked in parallel. Either way the clusters are numbered canonically.
+ */
+void ExpandAllClusters() {
+    if (g_cluster_config.num_threads > 0) {
+        // link the core points in parallel instead of expanding the clusters one by one
+        UnionFind core_sets(g_objects.size());
+        LinkCorePoints(core_sets);
+        AssignBorderPoints(core_sets);
+    } else {
+        while(IsObjectRemained()) {
+            // select a start point p randomly
+            int p = SelectStartObject();
+
+            // if the point is core, expand the cluster
+            if(IsCorePoint(g_objects[p])) {
+                g_objects[p].type = ObjectType::CORE;
+                g_objects[p].cluster_num = g_num_cluster;
+                ExpandCluster(p, g_num_cluster++);
+            } else {
+                // if not, mark as outlier
+                g_objects[p].type = ObjectType::OUTLIER;
+            }
         }
+        CanonicalizeBorderPoints();
     }
+    RenumberClusters();
 }
 
 /**
- * Retrieve all reachable points(neighbors) from each point
+ * Retrieve all reachable points(neighbors) from each point through the spatial index
+ * In the lazy mode, the neighbors are not stored but queried while expanding clusters.
  */
 void FindAllNeighbors() {
-    int end = g_objects.size();
-    for (int i = 0; i < end; i++) {
-        for (int j = 0; j < end; j++) {
-            if (IsReachable(g_objects[i], g_objects[j])) {
-               g_objects[i].neighbors.push_back(j); 
-            }
-        }
+    if (g_cluster_config.lazy) {
+        return;
+    }
+
+    // each object is queried by one thread into the buffer of the thread, and the neighbors
+    // are copied out so that each list holds no spare capacity
+    // the objects are queried in the order of the index, so the scanned cells stay in the cache
+    const vector<int> &order = g_index->Order();
+    vector<vector<int>> buffers(max(g_cluster_config.num_threads, 1));
+    ParallelFor(g_objects.size(), g_cluster_config.num_threads, [&](int thread, int pos) {
+        int i = order[pos];
+        g_index->RegionQuery(i, buffers[thread]);
+        g_objects[i].neighbors.assign(buffers[thread].begin(), buffers[thread].end());
+    });
+}
+
+/**
+ * Build the spatial index over the points
+ * The brute force index compares every pair, O(n^2), and is kept for validation.
+ * The grid index only scans the 3x3 cells around each point, and the k-d tree only
+ * visits the leaves within Eps.
+ * For the cosine metric, the index is built over the points scaled to the unit length.
+ */
+void BuildIndex() {
+    DistanceKernel kernel = MakeDistanceKernel(g_points.dims, g_cluster_config.metric, g_cluster_config.Eps);
+    if (g_cluster_config.metric == Metric::COSINE) {
+        g_normalized_points = NormalizePoints(g_points);
+    }
+    const PointSet &points = IndexedPoints();
+    if (g_cluster_config.index == IndexType::BRUTE_FORCE) {
+        g_index = new BruteForceIndex(points, kernel);
+    } else if (g_cluster_config.index == IndexType::KD_TREE) {
+        g_index = new KDTreeIndex(points, kernel);
+    } else {
+        g_index = new GridIndex(points, kernel);
     }
 }
 
 /**
- * Retrieve all core points and print out their x, y coordinate
+ * Release the spatial index after the last query
+ */
+void ReleaseIndex() {
+    delete g_index;
+    g_index = NULL;
+}
+
+/**
+ * Get the points the spatial index is built over
+ *
+ * @return      normalized points for the cosine metric, otherwise the input points
+ */
+const PointSet &IndexedPoints() {
+    return g_cluster_config.metric == Metric::COSINE ? g_normalized_points : g_points;
+}
+
+/**
+ * Retrieve all core points and print out their coordinates
+ * A point is core if it has at least MinPts neighbors (itself included)
+ * The core points are printed only for the cluster files output
  */
 void FindAllCores() {
-    string path_base = "./data/output/";
-    string path = path_base + g_input_file_name + "_cores.txt";
-    g_fs_output.open(path, ifstream::out);
-    if (g_fs_output.is_open() == false) {
-        cout << "Can't open output data file. Program terminated." << endl;
-        exit(0);
+    int min_pts = g_cluster_config.MinPts;
+    const vector<int> &order = g_index->Order();
+    ParallelFor(g_objects.size(), g_cluster_config.num_threads, [&](int, int pos) {
+        int i = order[pos];
+        object &obj = g_objects[i];
+        // the lazy mode counts the neighbors without storing them, up to MinPts
+        if (g_cluster_config.lazy) {
+            obj.is_core = g_index->CountNeighbors(i, min_pts) >= min_pts;
+        } else {
+            obj.is_core = (int)obj.neighbors.size() >= min_pts;
+        }
+    });
+    if (g_cluster_config.output != OutputMode::CLUSTERS) {
+        return;
     }
-    for (auto obj : g_objects) {
-        if (IsCorePoint(obj)) {
-           g_fs_output << obj.x << "\t" << obj.y << "\t" << endl;
+
+    string path_base = "./data/output/";
+    OpenOutput(g_fs_output, path_base + g_input_file_name + "_cores.txt");
+    int size = g_objects.size();
+    for (int i = 0; i < size; i++) {
+        if (IsCorePoint(g_objects[i])) {
+           PrintPoint(g_fs_output, i);
         }
     }
-    g_fs_output.close();
+    CloseOutput(g_fs_output);
 }
 
 /**
  * Determine whether there unvisited objects exist or not
+ * The cursor skips the objects visited by expansion, so each position of the start order
+ * is examined once over the whole clustering
  */
 bool IsObjectRemained() {
-    return g_unvisited_objs.size() > 0;
+    while (g_start_cursor < g_start_order.size() && g_visited[g_start_order[g_start_cursor]]) {
+        g_start_cursor++;
+    }
+    return g_start_cursor < g_start_order.size();
 }
 
 /**
  * Pick the one object for clustering start point from shuffled obeject vector 
+ * The first unvisited object of the start order, found by IsObjectRemained
  */
 int SelectStartObject() {
-    int oid = g_unvisited_objs[0];
+    int oid = g_start_order[g_start_cursor];
     MarkObjectVisted(oid);
     return oid;
 }
 
 /**
- * Remove given object id from unvisited object vector 
+ * Mark the object as visited in O(1)
  *
- * @param[in]  oid   object id to be removed 
+ * @param[in]  oid   object id to be marked 
  */
 void MarkObjectVisted(int oid) {
-    int idx = 0;
-    for (auto obj : g_unvisited_objs) {
-        if (obj == oid) {
-            g_unvisited_objs.erase(g_unvisited_objs.begin() + idx);
-            break;
-        } else {
-           idx++; 
-        }
-    }
+    g_visited[oid] = true;
 }
 
 /**
@@ -285,195 +551,637 @@ void MarkObjectVisted(int oid) {
  * @param[in]  examined object 
  */
 bool IsCorePoint(object &o) {
-    return (int)o.neighbors.size() >= g_cluster_config.MinPts;
+    return o.is_core;
 }
 
 /**
- * Expand cluster with DFS approach
- * All the expanded objects are same cluster
+ * Get the neighbors of the object, stored ones or queried from the spatial index
  *
- * @param[in]  center           new core point of expanding cluster 
- * @param[in]  cluster_num      cluster number 
+ * @param[in]   oid         object id
+ * @param[in]   buffer      buffer for the queried neighbors
+ * @return      neighbors of the object
  */
-void ExpandClusterDFS(object &center, int cluster_num) {
-    // check the neighbor objects as it is core
-    for (auto neighbor : center.neighbors) {
-        // if it is already classified as core, skip
-        if(g_objects[neighbor].type != ObjectType::CORE) {
-            MarkObjectVisted(neighbor);
-            g_objects[neighbor].cluster_num = cluster_num;
-
-            // if it is a core object,
-            // expand the cluster with same cluster number recursively
-            if(IsCorePoint(g_objects[neighbor])) {
-                g_objects[neighbor].type = ObjectType::CORE;
-                ExpandClusterDFS(g_objects[neighbor], cluster_num);
-            } else {
-                // if it is not a core, it is border. (could be outlier)
-                g_objects[neighbor].type = ObjectType::BORDER;
-            }
-        }
+const vector<int> &GetNeighbors(int oid, vector<int> &buffer) {
+    if (g_cluster_config.lazy) {
+        g_index->RegionQuery(oid, buffer);
+        return buffer;
     }
+    return g_objects[oid].neighbors;
 }
 
 /**
- * Expand cluster with BFS approach
+ * Expand cluster iteratively with an explicit stack(frontier) of core points
  * All the expanded objects are same cluster
+ * A core point is marked as CORE when it is pushed, so it is pushed only once and
+ * the frontier never holds more than the core points of the cluster.
+ * The frontier and the neighbor buffer are reused across clusters, and the call stack
+ * does not grow with the size of the cluster.
  *
  * @param[in]  center           new core point of expanding cluster 
  * @param[in]  cluster_num      cluster number 
  */
-void ExpandClusterBFS(int center, int cluster_num) {
-    int p = center;
-    std::queue<int> queue;
-    
-    queue.push(p);
-    while (!queue.empty()) {
-        p = queue.front();
-        queue.pop();
+void ExpandCluster(int center, int cluster_num) {
+    g_frontier.clear();
+    g_frontier.push_back(center);
+    while (!g_frontier.empty()) {
+        int p = g_frontier.back();
+        g_frontier.pop_back();
 
         // check the neighbor objects as it is core
-        for (auto neighbor : g_objects[p].neighbors) {
-            // if it is already classified as core, skip
-            if(g_objects[neighbor].type != ObjectType::CORE) {
+        for (auto neighbor : GetNeighbors(p, g_neighbor_buffer)) {
+            object &obj = g_objects[neighbor];
+            // if it is already classified as core, skip (it is expanded or in the frontier)
+            if (obj.type != ObjectType::CORE) {
                 MarkObjectVisted(neighbor);
-                g_objects[neighbor].cluster_num = cluster_num;
+                obj.cluster_num = cluster_num;
 
                 // if it is a core object,
                 // expand the cluster with same cluster number
-                if(IsCorePoint(g_objects[neighbor])) {
-                    g_objects[neighbor].type = ObjectType::CORE; queue.push(neighbor);
+                if (IsCorePoint(obj)) {
+                    obj.type = ObjectType::CORE;
+                    g_frontier.push_back(neighbor);
                 } else {
                     // if it is not a core, it is border. (could be outlier)
-                    g_objects[neighbor].type = ObjectType::BORDER;
+                    obj.type = ObjectType::BORDER;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Move each border point to the cluster of its core neighbor with the smallest object id
+ * A border point reachable from several clusters joins the one which expanded first,
+ * which depends on the start order. After this, the serial expansion gives the same
+ * clusters as the parallel clustering.
+ */
+void CanonicalizeBorderPoints() {
+    int size = g_objects.size();
+    for (int i = 0; i < size; i++) {
+        object &obj = g_objects[i];
+        if (obj.type != ObjectType::BORDER) {
+            continue;
+        }
+        int first_core = -1;
+        for (auto neighbor : GetNeighbors(i, g_neighbor_buffer)) {
+            if (IsCorePoint(g_objects[neighbor]) && (first_core < 0 || neighbor < first_core)) {
+                first_core = neighbor;
+            }
+        }
+        obj.cluster_num = g_objects[first_core].cluster_num;
+    }
+}
+
+/**
+ * Number the clusters canonically, in the order of their smallest member
+ * The numbers depend neither on the start order nor on the number of threads,
+ * so repeated runs print the same output files.
+ */
+void RenumberClusters() {
+    vector<int> renumber(g_num_cluster, -1);
+    int num_clusters = 0;
+    for (auto &obj : g_objects) {
+        if (obj.type == ObjectType::OUTLIER || obj.cluster_num < 0) {
+            obj.cluster_num = -1;
+            continue;
+        }
+        if (renumber[obj.cluster_num] < 0) {
+            renumber[obj.cluster_num] = num_clusters++;
+        }
+        obj.cluster_num = renumber[obj.cluster_num];
+    }
+    g_num_cluster = num_clusters;
+}
+
+/**
+ * Link every pair of core points within Eps into the same set, in parallel
+ * Each set of core points becomes a cluster, the same as the serial expansion finds.
+ *
+ * @param[out] core_sets        sets of the core points
+ */
+void LinkCorePoints(UnionFind &core_sets) {
+    int num_threads = max(g_cluster_config.num_threads, 1);
+    vector<vector<int>> buffers(num_threads);
+    const vector<int> &order = g_index->Order();
+    ParallelFor(g_objects.size(), num_threads, [&](int thread, int pos) {
+        int i = order[pos];
+        if (IsCorePoint(g_objects[i]) == false) {
+            return;
+        }
+        for (auto neighbor : GetNeighbors(i, buffers[thread])) {
+            // each pair is linked once, from the larger object id
+            if (neighbor < i && IsCorePoint(g_objects[neighbor])) {
+                core_sets.Union(i, neighbor);
+            }
+        }
+    });
+}
+
+/**
+ * Number the clusters and assign each border point to a cluster, in parallel
+ * The clusters are numbered in the order of their smallest core point(root of the set),
+ * and a border point joins the cluster of its core neighbor with the smallest object id,
+ * so the result does not depend on the number of threads.
+ *
+ * @param[in]  core_sets        sets of the core points linked by LinkCorePoints
+ */
+void AssignBorderPoints(UnionFind &core_sets) {
+    int size = g_objects.size();
+    vector<int> cluster_of_root(size, -1);
+    g_num_cluster = 0;
+    for (int i = 0; i < size; i++) {
+        if (IsCorePoint(g_objects[i]) && core_sets.Find(i) == i) {
+            cluster_of_root[i] = g_num_cluster++;
+        }
+    }
+
+    int num_threads = max(g_cluster_config.num_threads, 1);
+    vector<vector<int>> buffers(num_threads);
+    ParallelFor(size, num_threads, [&](int thread, int i) {
+        object &obj = g_objects[i];
+        if (IsCorePoint(obj)) {
+            obj.type = ObjectType::CORE;
+            obj.cluster_num = cluster_of_root[core_sets.Find(i)];
+            return;
+        }
+
+        int first_core = -1;
+        for (auto neighbor : GetNeighbors(i, buffers[thread])) {
+            if (IsCorePoint(g_objects[neighbor]) && (first_core < 0 || neighbor < first_core)) {
+                first_core = neighbor;
+            }
+        }
+        if (first_core < 0) {
+            obj.type = ObjectType::OUTLIER;
+        } else {
+            obj.type = ObjectType::BORDER;
+            obj.cluster_num = cluster_of_root[core_sets.Find(first_core)];
+        }
+    });
+}
+
+/**
+ * Cluster by the OPTICS ordering instead of DBSCAN, for several Eps at once
+ * 1. Order the objects by OPTICS with Eps and MinPts, each object is queried once
+ * 2. Print the ordering with the reachability and the core distance of each object
+ * 3. For each extracted Eps, extract the DBSCAN clustering from the ordering in a pass,
+ *    then reorganize and print it with the postfix '_eps' and the extracted Eps
+ */
+void OPTICS() {
+    BuildIndex();
+    int dims = g_points.dims;
+    Optics optics(IndexedPoints(), *g_index,
+            MakeDistanceKernel(dims, g_cluster_config.metric, g_cluster_config.Eps), g_cluster_config.MinPts);
+    optics.Run();
+    ReleaseIndex();
+    PrintReachability(optics);
+
+    string input_file_name = g_input_file_name;
+    for (auto &eps : g_cluster_config.extract_eps) {
+        DistanceKernel kernel = MakeDistanceKernel(dims, g_cluster_config.metric, atof(eps.c_str()));
+        g_num_cluster = optics.Extract(kernel.threshold, g_objects);
+        RenumberClusters();
+        g_input_file_name = input_file_name + "_eps" + eps;
+        ReorganizeCluster();
+        PrintCluster();
+    }
+    g_input_file_name = input_file_name;
+}
+
+/**
+ * Print the OPTICS ordering, a line per object in the order:
+ * object id, reachability distance and core distance (inf if undefined)
+ * The reachability plot shows a cluster as a valley, and the clusters of an Eps are
+ * the valleys below it.
+ *
+ * @param[in]   optics  ordered objects
+ */
+void PrintReachability(const Optics &optics) {
+    string path_base = "./data/output/";
+    OpenOutput(g_fs_output, path_base + g_input_file_name + "_reachability.txt");
+    for (auto oid : optics.Order()) {
+        g_fs_output.WriteInt(oid);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.WriteDouble(MetricDistance(g_cluster_config.metric, optics.Reachability(oid)));
+        g_fs_output.WriteChar('\t');
+        g_fs_output.WriteDouble(MetricDistance(g_cluster_config.metric, optics.CoreDistance(oid)));
+        g_fs_output.WriteChar('\n');
+    }
+    CloseOutput(g_fs_output);
+}
+
+/**
+ * Cluster the input, then insert the batch files one after another
+ * The clustering is kept up to date by the incremental DBSCAN, so a batch only updates
+ * the neighborhoods around its objects. The objects of a batch are numbered after the
+ * objects inserted before. After each batch, only the objects and the clusters it changed
+ * are printed with the postfix '_batch', the batch number and '_delta'. The input is printed
+ * the same way as batch 0, so the deltas can be replayed from it. The clustering of all
+ * the objects is reorganized and printed as usual for the input and once more, after the
+ * last batch, with the postfix of it.
+ */
+void IncrementalClustering() {
+    DistanceKernel kernel = MakeDistanceKernel(g_points.dims, g_cluster_config.metric, g_cluster_config.Eps);
+    IncrementalDBSCAN clusters(kernel, g_cluster_config.MinPts);
+    vector<int> touched;
+    vector<pair<int, int>> merged;
+    InsertObjects(clusters, g_points, touched, merged);
+    g_num_cluster = clusters.Label(g_objects);
+    ReorganizeCluster();
+    PrintCluster();
+    if (g_cluster_config.insert_paths.empty()) {
+        return;
+    }
+
+    // the input is batch 0, every object with the cluster named as in the deltas
+    string input_file_name = g_input_file_name;
+    g_input_file_name = input_file_name + "_batch0";
+    PrintBatchDelta(clusters, touched, vector<pair<int, int>>());
+
+    // the batches are kept as they are and appended to the points once at the end
+    vector<PointSet> batches;
+    for (size_t b = 0; b < g_cluster_config.insert_paths.size(); b++) {
+        const string &path = g_cluster_config.insert_paths[b];
+        PointFile batch_file;
+        PointSet batch;
+        if (batch_file.Load(path.c_str(), batch, g_cluster_config.num_threads) == false) {
+            cout << batch_file.Error() << " Program terminated." << endl;
+            exit(0);
+        }
+        if (batch.Size() > 0 && batch.dims != g_points.dims) {
+            cout << "Batch file " << path << " has a different number of coordinates. Program terminated." << endl;
+            exit(0);
+        }
+        cout << "insert file path: " << path << " num_objects: " << batch.Size() << endl;
+
+        InsertObjects(clusters, batch, touched, merged);
+        g_input_file_name = input_file_name + "_batch" + to_string(b + 1);
+        PrintBatchDelta(clusters, touched, merged);
+        // a mapped batch is copied before its file is closed
+        batches.push_back(PointSet());
+        batches.back().Append(batch);
+    }
+
+    vector<const PointSet *> sets;
+    for (auto &batch : batches) {
+        sets.push_back(&batch);
+    }
+    g_points.Append(sets);
+    vector<PointSet>().swap(batches);
+    g_objects.resize(g_points.Size());
+    g_num_cluster = clusters.Label(g_objects);
+    PrintOriginalObjects();
+    ReorganizeCluster();
+    PrintCluster();
+    g_input_file_name = input_file_name;
+}
+
+/**
+ * Print the changes of a batch to the clustering, a line per change:
+ * a merge of two clusters as 'cluster, new cluster, merge', then each object whose type
+ * or cluster changed as 'object id, cluster (-1 for outliers), type'.
+ * Clusters are named by their smallest core point, which does not change until they merge,
+ * so the clustering after the batch follows from the one before and the merges in order.
+ *
+ * @param[in]   clusters    incremental DBSCAN after the batch
+ * @param[in]   touched     objects whose type or core neighbor changed
+ * @param[in]   merged      (cluster, new cluster) of each merge in order
+ */
+void PrintBatchDelta(IncrementalDBSCAN &clusters, const vector<int> &touched, const vector<pair<int, int>> &merged) {
+    string path_base = "./data/output/";
+    OpenOutput(g_fs_output, path_base + g_input_file_name + "_delta.txt");
+    for (auto &merge : merged) {
+        g_fs_output.WriteInt(merge.first);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.WriteInt(merge.second);
+        g_fs_output.Write("\tmerge\n", 7);
+    }
+    for (auto oid : touched) {
+        ObjectType type = clusters.Type(oid);
+        const char *name = type == ObjectType::CORE ? "core" : type == ObjectType::BORDER ? "border" : "outlier";
+        g_fs_output.WriteInt(oid);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.WriteInt(clusters.Cluster(oid));
+        g_fs_output.WriteChar('\t');
+        g_fs_output.Write(name, strlen(name));
+        g_fs_output.WriteChar('\n');
+    }
+    CloseOutput(g_fs_output);
+}
+
+/**
+ * Insert objects into the incremental DBSCAN
+ * For the cosine metric, the objects are scaled to the unit length as the index does.
+ *
+ * @param[in]   clusters    incremental DBSCAN
+ * @param[in]   points      coordinates of the inserted objects
+ * @param[out]  touched     objects whose type or core neighbor changed
+ * @param[out]  merged      (cluster, new cluster) of each merge in order
+ */
+void InsertObjects(IncrementalDBSCAN &clusters, const PointSet &points, vector<int> &touched,
+        vector<pair<int, int>> &merged) {
+    if (g_cluster_config.metric == Metric::COSINE) {
+        clusters.Insert(NormalizePoints(points), touched, merged);
+    } else {
+        clusters.Insert(points, touched, merged);
+    }
+}
+
+/**
+ * Cluster the input streamed from the disk tile by tile, holding a tile at a time
+ * The clusters are reorganized with their sizes and centroids gathered from the tiles,
+ * and the labels are written from a label file in the order of the object ids.
+ */
+void TiledClustering() {
+    if (g_cluster_config.output == OutputMode::CLUSTERS) {
+        cout << "Tiled clustering writes --output labels or binary. Program terminated." << endl;
+        exit(0);
+    }
+    string path_base = "./data/output/";
+    string label_path = path_base + g_input_file_name + "_tiles.tmp";
+    string error;
+    int size = 0;
+    {
+        TiledDBSCAN tiles(g_cluster_config.metric, g_cluster_config.Eps, g_cluster_config.MinPts,
+                g_cluster_config.index, g_cluster_config.tile_size, path_base + g_input_file_name);
+        if (tiles.Partition(g_input_path.c_str()) && tiles.Cluster()) {
+            cout << "num_tiles: " << tiles.NumTiles() << " num_objects: " << tiles.Size() << endl;
+            g_num_cluster = tiles.NumClusters();
+            g_valid_clusters.assign(g_num_cluster, bool(true));
+            vector<int> remap(g_num_cluster);
+            for (int c = 0; c < g_num_cluster; c++) {
+                remap[c] = c;
+            }
+            if (MergeableClusters() > 0) {
+                remap = MergeClusters(tiles.ClusterSizes(), tiles.Centroids());
+            }
+
+            // valid clusters are numbered from 0 in order
+            vector<int> renumber(g_valid_clusters.size(), -1);
+            int num_clusters = 0;
+            for (size_t idx = 0; idx < g_valid_clusters.size(); idx++) {
+                if (g_valid_clusters[idx]) {
+                    renumber[idx] = num_clusters++;
                 }
             }
+            vector<int> label_of_cluster(remap.size());
+            for (size_t c = 0; c < remap.size(); c++) {
+                label_of_cluster[c] = renumber[remap[c]];
+            }
+            size = tiles.Size();
+            if (tiles.Label(label_of_cluster, label_path) == false) {
+                error = tiles.Error();
+            }
+        } else {
+            error = tiles.Error();
         }
     }
+    if (error.empty() == false) {
+        remove(label_path.c_str());
+        cout << error << " Program terminated." << endl;
+        exit(0);
+    }
+    PrintTiledLabels(label_path, size);
+    remove(label_path.c_str());
+    cout << "output file path: " << path_base << endl;
+}
+
+/**
+ * Print the labels of the tiled clustering as the output mode of the configuration
+ *
+ * @param[in]   label_path  label file, a TileLabel per object in the order of the object ids
+ * @param[in]   size        number of the objects
+ */
+void PrintTiledLabels(const string &label_path, int size) {
+    string path_base = "./data/output/";
+    bool binary = g_cluster_config.output == OutputMode::BINARY;
+    OpenOutput(g_fs_output, path_base + g_input_file_name + (binary ? "_labels.bin" : "_labels.txt"));
+    ifstream fs_labels(label_path, ifstream::in | ifstream::binary);
+    TileLabel label;
+    for (int j = 0; j < size && fs_labels.read((char *)&label, sizeof(label)); j++) {
+        if (binary) {
+            g_fs_output.Write((const char *)&label.cluster, sizeof(label.cluster));
+            continue;
+        }
+        const char *type = label.cluster < 0 ? "outlier" : label.type == (int32_t)ObjectType::CORE ? "core" : "border";
+        g_fs_output.WriteInt(j);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.WriteInt(label.cluster);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.Write(type, strlen(type));
+        g_fs_output.WriteChar('\n');
+    }
+    CloseOutput(g_fs_output);
 }
 
 /**
  * Reorganize the cluster to expected number of cluster
  * 0. If the expected number of cluster is smaller than DBSCAN found, do this routine
- * 1. Sort the clusters in descending order
- * 2. Calculate how many cluster should merge
- * 3. From the smallest cluster, merge the cluster into the nearest cluster
- *    here 'nearest cluster' means the closest distance between centroids
+ * 1. Calculate the centroid of every cluster in a pass over the objects
+ * 2. Calculate how many cluster should merge, and pop as many smallest clusters
+ *    from a heap ordered by size (the smaller id first among the same size)
+ * 3. Merge each of them into the nearest remaining cluster,
+ *    here 'nearest cluster' means the closest distance between centroids,
+ *    which is found by a k-d tree over the centroids of the remaining clusters
  * 4. After merging, change the cluster number from old one to new one
+ *    through a remap table in a pass over the objects
  */
 void ReorganizeCluster() {
-    // calculate how many cluster would be merged
-    int mergeable_cnt = g_num_cluster - g_cluster_config.num_clusters;
     g_valid_clusters.assign(g_num_cluster, bool(true));
-    // if there is a mergeable cluster
-    if (mergeable_cnt > 0) {
-        struct cluster {
-            int size = 0;
-            double center_x = 0.0;
-            double center_y = 0.0;
-        };
-
-        std::vector<struct cluster> clusters(g_num_cluster);
-
-        int cluster_num;
-        // calculate the centorid of each cluster
-        for (auto obj : g_objects) {
-            cluster_num = obj.cluster_num;
-            clusters[cluster_num].size++;
-            clusters[cluster_num].center_x += obj.x;
-            clusters[cluster_num].center_y += obj.y;
-        }
-
-        for (int i = 0; i < g_num_cluster; i++) {
-            clusters[i].center_x /= clusters[i].size;
-            clusters[i].center_y /= clusters[i].size;
-        }
-
-        // sort the clusters in descending order and find out merge target
-        for (int i = 0; i < mergeable_cnt; i++) {
-            int min_idx;
-            int min = INT_MAX;
-            int idx = 0;
-            for (auto &cluster : clusters) {
-                if (g_valid_clusters[idx] && min > cluster.size) {
-                    min = cluster.size;
-                    min_idx = idx;
-                } 
-                idx++;
+    if (MergeableClusters() <= 0) {
+        return;
+    }
+
+    // calculate the centroid of each cluster, outliers do not belong to any cluster
+    int dims = g_points.dims;
+    int size = g_objects.size();
+    vector<int> cluster_size(g_num_cluster, 0);
+    for (int i = 0; i < size; i++) {
+        if (g_objects[i].cluster_num >= 0) {
+            cluster_size[g_objects[i].cluster_num]++;
+        }
+    }
+    PointSet centroids;
+    centroids.dims = dims;
+    centroids.num_points = g_num_cluster;
+    centroids.coords.assign((size_t)dims * g_num_cluster, 0.0);
+    for (int d = 0; d < dims; d++) {
+        const double *coords = g_points.Dim(d);
+        double *center = centroids.coords.data() + (size_t)d * g_num_cluster;
+        for (int i = 0; i < size; i++) {
+            if (g_objects[i].cluster_num >= 0) {
+                center[g_objects[i].cluster_num] += coords[i];
             }
-            g_valid_clusters[min_idx] = false;
-        }
-
-        int src_idx = 0;
-        for (auto src_cluster : clusters) {
-            if (g_valid_clusters[src_idx] == false) {
-                int min_idx;
-                int min = INT_MAX;
-                int dst_idx = 0;
-
-                // for the target cluster, find out the nearest cluster to be 
-                for (auto dst_cluster : clusters) {
-                    double dst = sqrt((src_cluster.center_x - dst_cluster.center_x) 
-                            * (src_cluster.center_x - dst_cluster.center_x) 
-                            + (src_cluster.center_y - dst_cluster.center_y) 
-                            * (src_cluster.center_y - dst_cluster.center_y));
-                    if (g_valid_clusters[dst_idx] && min != 0 && min > dst) {
-                        min = dst;
-                        min_idx = dst_idx;
-                    } 
-                    dst_idx++;
-                }
+        }
+        for (int c = 0; c < g_num_cluster; c++) {
+            center[c] /= cluster_size[c];
+        }
+    }
 
-                // change the cluster number to new one 
-                for (auto &obj : g_objects) {
-                    if (obj.cluster_num == src_idx) {
-                        obj.cluster_num = min_idx;
-                    }
-                }
+    // change the cluster number to new one
+    vector<int> remap = MergeClusters(cluster_size, centroids);
+    for (auto &obj : g_objects) {
+        if (obj.cluster_num >= 0) {
+            obj.cluster_num = remap[obj.cluster_num];
+        }
+    }
+}
+
+/**
+ * Calculate how many cluster would be merged, at least a cluster remains
+ *
+ * @return      number of the clusters to be merged
+ */
+int MergeableClusters() {
+    return min(g_num_cluster - g_cluster_config.num_clusters, g_num_cluster - 1);
+}
+
+/**
+ * Merge the smallest clusters into the nearest remaining clusters
+ * The merged clusters are marked invalid in g_valid_clusters.
+ *
+ * @param[in]   cluster_size    objects of each cluster
+ * @param[in]   centroids       centroid of each cluster
+ * @return      remaining cluster of each cluster
+ */
+vector<int> MergeClusters(const vector<int> &cluster_size, const PointSet &centroids) {
+    int mergeable_cnt = MergeableClusters();
+    int dims = centroids.dims;
+
+    // the smallest clusters are merged
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> smallest;
+    for (int c = 0; c < g_num_cluster; c++) {
+        smallest.push(make_pair(cluster_size[c], c));
+    }
+    for (int i = 0; i < mergeable_cnt; i++) {
+        g_valid_clusters[smallest.top().second] = false;
+        smallest.pop();
+    }
+
+    // find the nearest remaining cluster of each merged cluster
+    vector<int> remaining;
+    for (int c = 0; c < g_num_cluster; c++) {
+        if (g_valid_clusters[c]) {
+            remaining.push_back(c);
+        }
+    }
+    PointSet remaining_centroids = centroids.Reorder(remaining);
+    // the centroids are compared in double even in the float32 mode
+    DistanceKernel centroid_kernel = MakeDistanceKernel(dims, Metric::EUCLIDEAN, 0.0);
+    centroid_kernel.single_precision = false;
+    KDTreeIndex centroid_tree(remaining_centroids, centroid_kernel);
+    vector<int> remap(g_num_cluster);
+    vector<double> center(dims);
+    for (int c = 0; c < g_num_cluster; c++) {
+        remap[c] = c;
+        if (g_valid_clusters[c] == false) {
+            for (int d = 0; d < dims; d++) {
+                center[d] = centroids.At(c, d);
             }
-            src_idx++;
+            remap[c] = remaining[centroid_tree.Nearest(center.data())];
         }
-        g_num_cluster = g_cluster_config.num_clusters;
     }
+    g_num_cluster -= mergeable_cnt;
+    return remap;
 }
 
 /**
  * Print clustered object data to output path
- * 1. Print x, y coordinate for each cluster
- * 2. Print object id for each cluster
+ * Valid clusters are numbered from 0 in order, and outliers have -1.
+ * The result is printed as the output mode of the configuration.
  */
 void PrintCluster() {
-    ofstream fs_cluster_id;
-    int i = 0;
-    int idx = 0;
-    string path_base = "./data/output/";
-    for (auto cluster : g_valid_clusters) {
-        if (cluster) {
-            string path = path_base + g_input_file_name + "_xy_" + to_string(i) + ".txt";
-            g_fs_output.open(path, ifstream::out);
-            if (g_fs_output.is_open() == false) {
-                cout << "Can't open output data file. Program terminated." << endl;
-                exit(0);
-            }
-            path = path_base + g_input_file_name + "_cluster_" + to_string(i) + ".txt";
-            fs_cluster_id.open(path, ifstream::out);
-            if (fs_cluster_id.is_open() == false) {
-                cout << "Can't open output data file. Program terminated." << endl;
-                exit(0);
-            }
+    vector<int> renumber(g_valid_clusters.size(), -1);
+    int num_clusters = 0;
+    for (size_t idx = 0; idx < g_valid_clusters.size(); idx++) {
+        if (g_valid_clusters[idx]) {
+            renumber[idx] = num_clusters++;
+        }
+    }
 
-            int size = g_objects.size();
-            for (int j = 0; j < size; j++) {
-                if (g_objects[j].cluster_num == idx && g_objects[j].type != ObjectType::OUTLIER) {
-                   g_fs_output << g_objects[j].x << "\t" << g_objects[j].y << "\t" << endl;
-                   fs_cluster_id << j << endl;
-                }
-            }
-            i++;
-            g_fs_output.close();
-            fs_cluster_id.close();
+    int size = g_objects.size();
+    vector<int> labels(size, -1);
+    for (int i = 0; i < size; i++) {
+        const object &obj = g_objects[i];
+        if (obj.cluster_num >= 0 && obj.type != ObjectType::OUTLIER) {
+            labels[i] = renumber[obj.cluster_num];
         }
-        idx++;
+    }
+
+    string path_base = "./data/output/";
+    if (g_cluster_config.output == OutputMode::LABELS) {
+        PrintLabels(labels);
+    } else if (g_cluster_config.output == OutputMode::BINARY) {
+        OpenOutput(g_fs_output, path_base + g_input_file_name + "_labels.bin");
+        g_fs_output.Write((const char *)labels.data(), sizeof(int) * labels.size());
+        CloseOutput(g_fs_output);
+    } else {
+        PrintClusterFiles(labels, num_clusters);
     }
     cout << "output file path: " << path_base << endl;
 }
+
+/**
+ * Print the coordinates and the object ids of each cluster in a pass
+ * The objects are counting sorted by their cluster with the ids ascending, so each pair of
+ * files is written sequentially
+ * 1. Print x, y coordinate for each cluster
+ * 2. Print object id for each cluster
+ *
+ * @param[in]   labels          cluster of each object, -1 for outliers
+ * @param[in]   num_clusters    number of clusters
+ */
+void PrintClusterFiles(const vector<int> &labels, int num_clusters) {
+    vector<int> begin(num_clusters + 1, 0);
+    for (int label : labels) {
+        if (label >= 0) {
+            begin[label + 1]++;
+        }
+    }
+    for (int i = 0; i < num_clusters; i++) {
+        begin[i + 1] += begin[i];
+    }
+    vector<int> members(begin[num_clusters]);
+    vector<int> next(begin.begin(), begin.end() - 1);
+    int size = labels.size();
+    for (int j = 0; j < size; j++) {
+        if (labels[j] >= 0) {
+            members[next[labels[j]]++] = j;
+        }
+    }
+
+    BufferedWriter fs_cluster_id;
+    string path_base = "./data/output/";
+    for (int i = 0; i < num_clusters; i++) {
+        OpenOutput(g_fs_output, path_base + g_input_file_name + "_xy_" + to_string(i) + ".txt");
+        OpenOutput(fs_cluster_id, path_base + g_input_file_name + "_cluster_" + to_string(i) + ".txt");
+        for (int k = begin[i]; k < begin[i + 1]; k++) {
+            PrintPoint(g_fs_output, members[k]);
+            fs_cluster_id.WriteInt(members[k]);
+            fs_cluster_id.WriteChar('\n');
+        }
+        CloseOutput(g_fs_output);
+        CloseOutput(fs_cluster_id);
+    }
+}
+
+/**
+ * Print a line per object: object id, cluster(-1 for outliers) and type
+ *
+ * @param[in]   labels      cluster of each object, -1 for outliers
+ */
+void PrintLabels(const vector<int> &labels) {
+    string path_base = "./data/output/";
+    OpenOutput(g_fs_output, path_base + g_input_file_name + "_labels.txt");
+    int size = labels.size();
+    for (int j = 0; j < size; j++) {
+        const char *type = labels[j] < 0 ? "outlier" : IsCorePoint(g_objects[j]) ? "core" : "border";
+        g_fs_output.WriteInt(j);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.WriteInt(labels[j]);
+        g_fs_output.WriteChar('\t');
+        g_fs_output.Write(type, strlen(type));
+        g_fs_output.WriteChar('\n');
+    }
+    CloseOutput(g_fs_output);
+}
@@ -0,0 +1,66 @@
+/**
+ * Perform clustering on a given data set by using DBSCAN.
+ * Entry point of the clustering program, the clustering itself is in DBSCAN.cc
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        clustering.cc
+ */
+
+#include "DBSCAN.h"
+#include <iostream>
+
+/**
+ * @param[in]   command line arguments as below:
+ *              argv[0] executable file
+ *              argv[1] input data file, a line per object: object id and its coordinates,
+ *                      any number of coordinates but the same on every line,
+ *                      or a binary point file saved by --save-points
+ *              argv[2] n: number of clusters
+ *              argv[3] Eps: maximum radius of the neighborhood
+ *              argv[4] MinPts: minimum number of points 
+ *                              in an Eps-neighborhood of a given point
+ *              options:
+ *              --index I       spatial index for finding neighbors:
+ *                              grid(default), kdtree or brute(reference for validation)
+ *              --lazy on|off   query the neighbors while expanding clusters instead of
+ *                              storing the neighbors of every point
+ *              --threads N     cluster with N threads by linking the core points with
+ *                              union-find instead of the serial expansion
+ *              --metric M      distance between objects:
+ *                              euclidean(default), manhattan or cosine(1 - cosine similarity)
+ *              --output O      clusters(default): the original objects, the core points,
+ *                              and the coordinates and the object ids of each cluster,
+ *                              labels: a text file of object id, cluster and type,
+ *                              binary: the cluster of each object as int32 (-1: outlier)
+ *              --save-points P save the input points as a binary point file, which is
+ *                              mapped without parsing when it is given as the input
+ *              --simd K        distance kernel: auto(default, the widest supported),
+ *                              avx512, avx2 or scalar
+ *              --optics E1,E2  order the objects by OPTICS with Eps once, and extract
+ *                              the clustering of each Eps given, at most Eps
+ *              --insert B1,B2  insert the objects of each batch file after the input,
+ *                              print the changes of each batch to the clustering,
+ *                              and print the clustering of all the objects at the end
+ *              --tile-size N   cluster the input streamed from the disk in tiles of
+ *                              about N objects, with --output labels or binary
+ *              --seed S        seed of the random start order (default: the current time),
+ *                              the output does not depend on it
+ *              --precision P   double(default) or float: the indices store and scan
+ *                              the coordinates rounded to float, half the bytes
+ * @return      0
+ */
+int main(int argc, const char *argv[]) {
+    if (InitCLA(argc, argv)) {
+        RunClustering();
+    } else {
+        cout << "Invalid usage. Please check the arguments." << endl
+           << "$ [executable file] [input data file] [number of clusters] [Eps] [MinPts] "
+           << "[--index grid|kdtree|brute] [--lazy on|off] [--threads N] "
+           << "[--metric euclidean|manhattan|cosine] [--simd auto|avx512|avx2|scalar] "
+           << "[--output clusters|labels|binary] [--save-points path] [--optics Eps1,Eps2,...] "
+           << "[--insert batch1,batch2,...] [--tile-size N] [--seed S] [--precision double|float]" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,527 @@
+/**
+ * Distance kernels testing a center against a block of points
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        distance.cc
+ */
+
+#include "distance.h"
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DISTANCE_X86
+#include <immintrin.h>
+#endif
+
+#define DISTANCE_INLINE inline __attribute__((always_inline))
+
+namespace {
+
+enum class InstructionSet {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+/**
+ * Metric policies: the term of a coordinate difference, for each instruction set
+ * Kernels sum the terms from the first dimension in the same order on every
+ * instruction set and use no fma, so every kernel rounds the distance the same way.
+ * Each term has a double and a float version.
+ */
+struct EuclideanPolicy {
+    template <typename T>
+    static DISTANCE_INLINE T Term(T diff) {
+        return diff * diff;
+    }
+#ifdef DISTANCE_X86
+    __attribute__((target("avx2")))
+    static DISTANCE_INLINE __m256d TermAVX2(__m256d diff) {
+        return _mm256_mul_pd(diff, diff);
+    }
+    __attribute__((target("avx2")))
+    static DISTANCE_INLINE __m256 TermAVX2(__m256 diff) {
+        return _mm256_mul_ps(diff, diff);
+    }
+    __attribute__((target("avx512f")))
+    static DISTANCE_INLINE __m512d TermAVX512(__m512d diff) {
+        return _mm512_mul_pd(diff, diff);
+    }
+    __attribute__((target("avx512f")))
+    static DISTANCE_INLINE __m512 TermAVX512(__m512 diff) {
+        return _mm512_mul_ps(diff, diff);
+    }
+#endif
+};
+
+struct ManhattanPolicy {
+    template <typename T>
+    static DISTANCE_INLINE T Term(T diff) {
+        return fabs(diff);
+    }
+#ifdef DISTANCE_X86
+    __attribute__((target("avx2")))
+    static DISTANCE_INLINE __m256d TermAVX2(__m256d diff) {
+        return _mm256_andnot_pd(_mm256_set1_pd(-0.0), diff);
+    }
+    __attribute__((target("avx2")))
+    static DISTANCE_INLINE __m256 TermAVX2(__m256 diff) {
+        return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), diff);
+    }
+    __attribute__((target("avx512f")))
+    static DISTANCE_INLINE __m512d TermAVX512(__m512d diff) {
+        return _mm512_abs_pd(diff);
+    }
+    __attribute__((target("avx512f")))
+    static DISTANCE_INLINE __m512 TermAVX512(__m512 diff) {
+        return _mm512_abs_ps(diff);
+    }
+#endif
+};
+
+/**
+ * Kernels for D dimensions, D is 0 for the number of dimensions given at runtime
+ * The loop over the dimensions is unrolled when D is known.
+ * The scalar kernels are templates of the coordinate type T, double or float.
+ */
+template <int D, typename Policy, typename T>
+int ScanScalar(const T *center, const T *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits) {
+    const int num_dims = D > 0 ? D : dims;
+    const T largest = threshold;
+    int num_hits = 0;
+    for (int i = 0; i < size; i++) {
+        T dist = 0;
+        for (int d = 0; d < num_dims; d++) {
+            dist += Policy::Term(block[(size_t)d * stride + i] - center[(size_t)d * stride]);
+        }
+        if (dist <= largest) {
+            hits[num_hits++] = ids[i];
+        }
+    }
+    return num_hits;
+}
+
+template <typename Policy>
+double DistanceScalar(const double *a, const double *b, int stride, int dims) {
+    double dist = 0.0;
+    for (int d = 0; d < dims; d++) {
+        dist += Policy::Term(b[(size_t)d * stride] - a[(size_t)d * stride]);
+    }
+    return dist;
+}
+
+template <int D, typename Policy, typename T>
+int CountScalar(const T *center, const T *block, int stride, int dims,
+        int size, double threshold, int limit) {
+    const int num_dims = D > 0 ? D : dims;
+    const T largest = threshold;
+    int count = 0;
+    for (int i = 0; i < size && count < limit; i++) {
+        T dist = 0;
+        for (int d = 0; d < num_dims; d++) {
+            dist += Policy::Term(block[(size_t)d * stride + i] - center[(size_t)d * stride]);
+        }
+        if (dist <= largest) {
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifdef DISTANCE_X86
+template <int D, typename Policy>
+__attribute__((target("avx2")))
+DISTANCE_INLINE __m256d DistanceAVX2(const double *center, const double *block, int stride, int dims, int i) {
+    const int num_dims = D > 0 ? D : dims;
+    __m256d dist = _mm256_setzero_pd();
+    for (int d = 0; d < num_dims; d++) {
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(block + (size_t)d * stride + i),
+                _mm256_set1_pd(center[(size_t)d * stride]));
+        dist = _mm256_add_pd(dist, Policy::TermAVX2(diff));
+    }
+    return dist;
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx2")))
+int ScanAVX2(const double *center, const double *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits) {
+    __m256d vthreshold = _mm256_set1_pd(threshold);
+    int num_hits = 0;
+    int i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m256d dist = DistanceAVX2<D, Policy>(center, block, stride, dims, i);
+        unsigned mask = _mm256_movemask_pd(_mm256_cmp_pd(dist, vthreshold, _CMP_LE_OQ));
+        while (mask != 0) {
+            hits[num_hits++] = ids[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+    }
+    return num_hits + ScanScalar<D, Policy, double>(center, block + i, stride, dims, ids + i, size - i,
+            threshold, hits + num_hits);
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx2")))
+int CountAVX2(const double *center, const double *block, int stride, int dims,
+        int size, double threshold, int limit) {
+    __m256d vthreshold = _mm256_set1_pd(threshold);
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= size && count < limit; i += 4) {
+        __m256d dist = DistanceAVX2<D, Policy>(center, block, stride, dims, i);
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(dist, vthreshold, _CMP_LE_OQ)));
+    }
+    if (count >= limit) {
+        return count;
+    }
+    return count + CountScalar<D, Policy, double>(center, block + i, stride, dims, size - i,
+            threshold, limit - count);
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx512f")))
+DISTANCE_INLINE __m512d DistanceAVX512(const double *center, const double *block, int stride, int dims, int i) {
+    const int num_dims = D > 0 ? D : dims;
+    __m512d dist = _mm512_setzero_pd();
+    for (int d = 0; d < num_dims; d++) {
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(block + (size_t)d * stride + i),
+                _mm512_set1_pd(center[(size_t)d * stride]));
+        dist = _mm512_add_pd(dist, Policy::TermAVX512(diff));
+    }
+    return dist;
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx512f,avx512vl")))
+int ScanAVX512(const double *center, const double *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits) {
+    __m512d vthreshold = _mm512_set1_pd(threshold);
+    int num_hits = 0;
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m512d dist = DistanceAVX512<D, Policy>(center, block, stride, dims, i);
+        __mmask8 mask = _mm512_cmp_pd_mask(dist, vthreshold, _CMP_LE_OQ);
+        // pack the ids of the hits to the front of the output
+        __m256i block_ids = _mm256_loadu_si256((const __m256i *)(ids + i));
+        _mm256_mask_compressstoreu_epi32(hits + num_hits, mask, block_ids);
+        num_hits += __builtin_popcount(mask);
+    }
+    return num_hits + ScanScalar<D, Policy, double>(center, block + i, stride, dims, ids + i, size - i,
+            threshold, hits + num_hits);
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx512f")))
+int CountAVX512(const double *center, const double *block, int stride, int dims,
+        int size, double threshold, int limit) {
+    __m512d vthreshold = _mm512_set1_pd(threshold);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= size && count < limit; i += 8) {
+        __m512d dist = DistanceAVX512<D, Policy>(center, block, stride, dims, i);
+        count += __builtin_popcount(_mm512_cmp_pd_mask(dist, vthreshold, _CMP_LE_OQ));
+    }
+    if (count >= limit) {
+        return count;
+    }
+    return count + CountScalar<D, Policy, double>(center, block + i, stride, dims, size - i,
+            threshold, limit - count);
+}
+
+/**
+ * Kernels over float coordinates, 8 points at once with AVX2 and 16 with AVX-512
+ * A cell or a leaf often holds fewer than 16 points, so AVX-512 tests the rest with masked loads.
+ */
+template <int D, typename Policy>
+__attribute__((target("avx2")))
+DISTANCE_INLINE __m256 DistanceFloatAVX2(const float *center, const float *block, int stride, int dims, int i) {
+    const int num_dims = D > 0 ? D : dims;
+    __m256 dist = _mm256_setzero_ps();
+    for (int d = 0; d < num_dims; d++) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(block + (size_t)d * stride + i),
+                _mm256_set1_ps(center[(size_t)d * stride]));
+        dist = _mm256_add_ps(dist, Policy::TermAVX2(diff));
+    }
+    return dist;
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx2")))
+int ScanFloatAVX2(const float *center, const float *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits) {
+    __m256 vthreshold = _mm256_set1_ps((float)threshold);
+    int num_hits = 0;
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256 dist = DistanceFloatAVX2<D, Policy>(center, block, stride, dims, i);
+        unsigned mask = _mm256_movemask_ps(_mm256_cmp_ps(dist, vthreshold, _CMP_LE_OQ));
+        while (mask != 0) {
+            hits[num_hits++] = ids[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+    }
+    return num_hits + ScanScalar<D, Policy, float>(center, block + i, stride, dims, ids + i, size - i,
+            threshold, hits + num_hits);
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx2")))
+int CountFloatAVX2(const float *center, const float *block, int stride, int dims,
+        int size, double threshold, int limit) {
+    __m256 vthreshold = _mm256_set1_ps((float)threshold);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= size && count < limit; i += 8) {
+        __m256 dist = DistanceFloatAVX2<D, Policy>(center, block, stride, dims, i);
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(dist, vthreshold, _CMP_LE_OQ)));
+    }
+    if (count >= limit) {
+        return count;
+    }
+    return count + CountScalar<D, Policy, float>(center, block + i, stride, dims, size - i,
+            threshold, limit - count);
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx512f")))
+DISTANCE_INLINE __m512 DistanceFloatAVX512(const float *center, const float *block, int stride, int dims, int i,
+        __mmask16 lanes) {
+    const int num_dims = D > 0 ? D : dims;
+    __m512 dist = _mm512_setzero_ps();
+    for (int d = 0; d < num_dims; d++) {
+        __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, block + (size_t)d * stride + i),
+                _mm512_set1_ps(center[(size_t)d * stride]));
+        dist = _mm512_add_ps(dist, Policy::TermAVX512(diff));
+    }
+    return dist;
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx512f")))
+int ScanFloatAVX512(const float *center, const float *block, int stride, int dims,
+        const int *ids, int size, double threshold, int *hits) {
+    __m512 vthreshold = _mm512_set1_ps((float)threshold);
+    int num_hits = 0;
+    for (int i = 0; i < size; i += 16) {
+        // the last block loads only the points left
+        __mmask16 lanes = size - i >= 16 ? 0xFFFF : (__mmask16)((1u << (size - i)) - 1);
+        __m512 dist = DistanceFloatAVX512<D, Policy>(center, block, stride, dims, i, lanes);
+        __mmask16 mask = _mm512_mask_cmp_ps_mask(lanes, dist, vthreshold, _CMP_LE_OQ);
+        // pack the ids of the hits to the front of the output
+        __m512i block_ids = _mm512_maskz_loadu_epi32(lanes, ids + i);
+        _mm512_mask_compressstoreu_epi32(hits + num_hits, mask, block_ids);
+        num_hits += __builtin_popcount(mask);
+    }
+    return num_hits;
+}
+
+template <int D, typename Policy>
+__attribute__((target("avx512f")))
+int CountFloatAVX512(const float *center, const float *block, int stride, int dims,
+        int size, double threshold, int limit) {
+    __m512 vthreshold = _mm512_set1_ps((float)threshold);
+    int count = 0;
+    for (int i = 0; i < size && count < limit; i += 16) {
+        __mmask16 lanes = size - i >= 16 ? 0xFFFF : (__mmask16)((1u << (size - i)) - 1);
+        __m512 dist = DistanceFloatAVX512<D, Policy>(center, block, stride, dims, i, lanes);
+        count += __builtin_popcount(_mm512_mask_cmp_ps_mask(lanes, dist, vthreshold, _CMP_LE_OQ));
+    }
+    return count;
+}
+#endif // DISTANCE_X86
+
+/**
+ * Pick the widest instruction set the processor supports
+ */
+InstructionSet DetectInstructionSet() {
+#ifdef DISTANCE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+        return InstructionSet::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return InstructionSet::AVX2;
+    }
+#endif
+    return InstructionSet::SCALAR;
+}
+
+bool g_isa_selected = false;
+InstructionSet g_isa = InstructionSet::SCALAR;
+bool g_single_precision = false;
+
+template <int D, typename Policy>
+void SetKernels(DistanceKernel &kernel) {
+#ifdef DISTANCE_X86
+    if (g_isa == InstructionSet::AVX512) {
+        kernel.name = "avx512";
+        kernel.scan = ScanAVX512<D, Policy>;
+        kernel.count = CountAVX512<D, Policy>;
+        kernel.scan_float = ScanFloatAVX512<D, Policy>;
+        kernel.count_float = CountFloatAVX512<D, Policy>;
+        return;
+    }
+    if (g_isa == InstructionSet::AVX2) {
+        kernel.name = "avx2";
+        kernel.scan = ScanAVX2<D, Policy>;
+        kernel.count = CountAVX2<D, Policy>;
+        kernel.scan_float = ScanFloatAVX2<D, Policy>;
+        kernel.count_float = CountFloatAVX2<D, Policy>;
+        return;
+    }
+#endif
+    kernel.name = "scalar";
+    kernel.scan = ScanScalar<D, Policy, double>;
+    kernel.count = CountScalar<D, Policy, double>;
+    kernel.scan_float = ScanScalar<D, Policy, float>;
+    kernel.count_float = CountScalar<D, Policy, float>;
+}
+
+/**
+ * Specialize the kernels for the common small numbers of dimensions
+ */
+template <typename Policy>
+void SetKernels(DistanceKernel &kernel, int dims) {
+    kernel.distance = DistanceScalar<Policy>;
+    switch (dims) {
+    case 2:
+        SetKernels<2, Policy>(kernel);
+        break;
+    case 3:
+        SetKernels<3, Policy>(kernel);
+        break;
+    case 4:
+        SetKernels<4, Policy>(kernel);
+        break;
+    case 8:
+        SetKernels<8, Policy>(kernel);
+        break;
+    default:
+        SetKernels<0, Policy>(kernel);
+        break;
+    }
+}
+
+} // namespace
+
+/**
+ * Make the kernels of the selected instruction set for the points and the metric
+ * The cosine distance of two normalized points a, b is |a - b|^2 / 2, so the points
+ * are normalized by NormalizePoints and compared by the Euclidean kernels with 2 * Eps.
+ * In the float32 mode, the radius is widened by the rounding of the float terms and sums,
+ * so a neighbor found in float still differs by at most the radius in each coordinate.
+ *
+ * @param[in]   dims        number of dimensions
+ * @param[in]   metric      distance metric
+ * @param[in]   eps         Eps
+ * @return      the kernels
+ */
+DistanceKernel MakeDistanceKernel(int dims, Metric metric, double eps) {
+    if (g_isa_selected == false) {
+        g_isa = DetectInstructionSet();
+        g_isa_selected = true;
+    }
+
+    DistanceKernel kernel;
+    kernel.dims = dims;
+    if (metric == Metric::MANHATTAN) {
+        SetKernels<ManhattanPolicy>(kernel, dims);
+        kernel.threshold = eps;
+        kernel.radius = eps;
+    } else if (metric == Metric::COSINE) {
+        SetKernels<EuclideanPolicy>(kernel, dims);
+        kernel.threshold = 2.0 * eps;
+        kernel.radius = sqrt(max(2.0 * eps, 0.0));
+    } else {
+        SetKernels<EuclideanPolicy>(kernel, dims);
+        kernel.threshold = eps * eps;
+        kernel.radius = eps;
+    }
+    kernel.single_precision = g_single_precision;
+    if (g_single_precision) {
+        kernel.radius *= 1.0 + (dims + 3) * FLT_EPSILON;
+    }
+    return kernel;
+}
+
+/**
+ * Select the instruction set of the kernels by its name (auto, avx512, avx2 or scalar)
+ *
+ * @param[in]   name    name of the instruction set
+ * @return      false if it is unknown or not supported by the processor
+ */
+bool SelectDistanceKernel(const char *name) {
+    InstructionSet best = DetectInstructionSet();
+    if (strcmp(name, "auto") == 0) {
+        g_isa = best;
+    } else if (strcmp(name, "scalar") == 0) {
+        g_isa = InstructionSet::SCALAR;
+    } else if (strcmp(name, "avx2") == 0 && best >= InstructionSet::AVX2) {
+        g_isa = InstructionSet::AVX2;
+    } else if (strcmp(name, "avx512") == 0 && best >= InstructionSet::AVX512) {
+        g_isa = InstructionSet::AVX512;
+    } else {
+        return false;
+    }
+    g_isa_selected = true;
+    return true;
+}
+
+/**
+ * Select the precision of the coordinates scanned by the indices
+ *
+ * @param[in]   single  float32 coordinates if true, otherwise double
+ */
+void SelectPrecision(bool single) {
+    g_single_precision = single;
+}
+
+/**
+ * Scale every point to the unit length for the cosine distance
+ * A zero point stays at the origin, at the distance 1/2 from every normalized point.
+ *
+ * @param[in]   points      coordinates of all input objects
+ * @return      normalized coordinates
+ */
+PointSet NormalizePoints(const PointSet &points) {
+    int size = points.Size();
+    PointSet normalized;
+    normalized.dims = points.dims;
+    normalized.num_points = size;
+    normalized.coords.assign(points.Data(), points.Data() + (size_t)points.dims * size);
+    for (int i = 0; i < size; i++) {
+        double norm = 0.0;
+        for (int d = 0; d < points.dims; d++) {
+            norm += points.At(i, d) * points.At(i, d);
+        }
+        if (norm > 0.0) {
+            norm = sqrt(norm);
+            for (int d = 0; d < points.dims; d++) {
+                normalized.coords[(size_t)d * size + i] /= norm;
+            }
+        }
+    }
+    return normalized;
+}
+
+/**
+ * Convert an accumulated distance of the kernels into the distance of the metric
+ *
+ * @param[in]   metric      distance metric
+ * @param[in]   accumulated accumulated distance of two points
+ * @return      distance between the points
+ */
+double MetricDistance(Metric metric, double accumulated) {
+    if (metric == Metric::MANHATTAN) {
+        return accumulated;
+    } else if (metric == Metric::COSINE) {
+        return accumulated / 2.0;
+    }
+    return sqrt(accumulated);
+}
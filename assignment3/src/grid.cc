@@ -0,0 +1,278 @@
+/**
+ * Uniform grid index for the region query of DBSCAN
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        grid.cc
+ */
+
+#include "grid.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Interleave the lower 32 bits of a value with zeros, bit k moves to bit 2k
+ */
+static uint64_t SpreadBits(uint64_t x) {
+    x &= 0xFFFFFFFFULL;
+    x = (x | x << 16) & 0x0000FFFF0000FFFFULL;
+    x = (x | x << 8) & 0x00FF00FF00FF00FFULL;
+    x = (x | x << 4) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | x << 2) & 0x3333333333333333ULL;
+    x = (x | x << 1) & 0x5555555555555555ULL;
+    return x;
+}
+
+/**
+ * Build the grid in one pass over the objects
+ * The objects are counting sorted by their cell, then the non-empty cells are ordered
+ * by their Morton key. If there are much more cells than objects (sparse data),
+ * the objects are sorted by the key and the non-empty cells are found by binary search.
+ * The coordinates are copied in the sorted order, so the cells are scanned
+ * by the distance kernel as contiguous arrays.
+ * Cells are laid over the first two dimensions, a neighbor differs by at most the
+ * radius of the kernel in each of them.
+ * In the float32 mode, the cells are found by the coordinates rounded to float,
+ * and the copy is kept only as float.
+ *
+ * @param[in]   points      coordinates of all input objects
+ * @param[in]   kernel      distance kernel for the metric and Eps
+ */
+GridIndex::GridIndex(const PointSet &points, const DistanceKernel &kernel)
+: kernel_(kernel), side_(kernel.radius > 0 ? kernel.radius : 1.0),
+  min_x_(0.0), min_y_(0.0), num_cols_(1), num_rows_(1), morton_(true), dense_(true) {
+    int size = points.Size();
+    if (size == 0) {
+        cell_slot_.assign(1, -1);
+        return;
+    }
+
+    // a single dimension is laid on one row of cells
+    vector<double> zeros;
+    if (points.dims < 2) {
+        zeros.assign(size, 0.0);
+    }
+    const double *xs = points.Dim(0);
+    const double *ys = points.dims < 2 ? zeros.data() : points.Dim(1);
+    min_x_ = Round(*min_element(xs, xs + size));
+    min_y_ = Round(*min_element(ys, ys + size));
+    num_cols_ = Col(Round(*max_element(xs, xs + size))) + 1;
+    num_rows_ = Row(Round(*max_element(ys, ys + size))) + 1;
+
+    morton_ = num_cols_ <= (1LL << 32) && num_rows_ <= (1LL << 32);
+
+    order_.resize(size);
+    dense_ = (double)num_cols_ * num_rows_ <= 4.0 * size;
+    if (dense_) {
+        // counting sort by the cell numbered row by row, object ids stay ascending in a cell
+        int64_t num_cells = num_cols_ * num_rows_;
+        vector<int> cells(size);
+        vector<int> begin(num_cells + 1, 0);
+        for (int i = 0; i < size; i++) {
+            cells[i] = Row(Round(ys[i])) * num_cols_ + Col(Round(xs[i]));
+            begin[cells[i] + 1]++;
+        }
+        for (int64_t i = 0; i < num_cells; i++) {
+            begin[i + 1] += begin[i];
+        }
+        vector<int> bucketed(size);
+        vector<int> next(begin.begin(), begin.end() - 1);
+        for (int i = 0; i < size; i++) {
+            bucketed[next[cells[i]]++] = i;
+        }
+
+        // the non-empty cells in the order of their keys
+        vector<pair<uint64_t, int>> keys;
+        for (int64_t cell = 0; cell < num_cells; cell++) {
+            if (begin[cell] < begin[cell + 1]) {
+                keys.push_back(make_pair(CellKey(cell % num_cols_, cell / num_cols_), (int)cell));
+            }
+        }
+        if (morton_) {
+            sort(keys.begin(), keys.end());
+        }
+        cell_slot_.assign(num_cells, -1);
+        int pos = 0;
+        for (auto &key : keys) {
+            cell_slot_[key.second] = cell_begin_.size();
+            cell_begin_.push_back(pos);
+            for (int k = begin[key.second]; k < begin[key.second + 1]; k++) {
+                order_[pos++] = bucketed[k];
+            }
+        }
+        cell_begin_.push_back(size);
+    } else {
+        vector<uint64_t> keys(size);
+        for (int i = 0; i < size; i++) {
+            keys[i] = CellKey(Col(Round(xs[i])), Row(Round(ys[i])));
+            order_[i] = i;
+        }
+        stable_sort(order_.begin(), order_.end(), [&](int a, int b) {
+            return keys[a] < keys[b];
+        });
+        for (int i = 0; i < size; i++) {
+            uint64_t key = keys[order_[i]];
+            if (cell_keys_.empty() || cell_keys_.back() != key) {
+                cell_keys_.push_back(key);
+                cell_begin_.push_back(i);
+            }
+        }
+        cell_begin_.push_back(size);
+    }
+
+    if (kernel.single_precision) {
+        sorted_.dims = points.dims;
+        sorted_.num_points = size;
+        sorted_float_ = points.ReorderFloat(order_);
+    } else {
+        sorted_ = points.Reorder(order_);
+    }
+    rank_.resize(size);
+    for (int i = 0; i < size; i++) {
+        rank_[order_[i]] = i;
+    }
+}
+
+int64_t GridIndex::Col(double x) const {
+    return (int64_t)floor((x - min_x_) / side_);
+}
+
+int64_t GridIndex::Row(double y) const {
+    return (int64_t)floor((y - min_y_) / side_);
+}
+
+/**
+ * Round a coordinate to float in the float32 mode, so the cells match the copy being scanned
+ */
+double GridIndex::Round(double x) const {
+    return kernel_.single_precision ? (double)(float)x : x;
+}
+
+/**
+ * Coordinate of the object at a position of order_, from the copy being scanned
+ */
+double GridIndex::Coord(int pos, int d) const {
+    if (kernel_.single_precision) {
+        return sorted_float_[(size_t)d * sorted_.Size() + pos];
+    }
+    return sorted_.At(pos, d);
+}
+
+/**
+ * Key of a cell: the Morton code of its column and row, or the cell numbered row by row
+ */
+uint64_t GridIndex::CellKey(int64_t col, int64_t row) const {
+    if (morton_) {
+        return SpreadBits(col) | SpreadBits(row) << 1;
+    }
+    return row * num_cols_ + col;
+}
+
+/**
+ * Find the range of the sorted objects in a cell
+ *
+ * @param[in]   col, row        column and row of the cell
+ * @param[out]  begin, end      range of order_, empty if the cell has no object
+ */
+void GridIndex::CellRange(int64_t col, int64_t row, int &begin, int &end) const {
+    int slot;
+    if (dense_) {
+        slot = cell_slot_[row * num_cols_ + col];
+    } else {
+        uint64_t key = CellKey(col, row);
+        auto found = lower_bound(cell_keys_.begin(), cell_keys_.end(), key);
+        slot = found != cell_keys_.end() && *found == key ? found - cell_keys_.begin() : -1;
+    }
+    begin = slot < 0 ? 0 : cell_begin_[slot];
+    end = slot < 0 ? 0 : cell_begin_[slot + 1];
+}
+
+/**
+ * Visit the ranges of the sorted objects in the 3x3 cells around the object
+ * Cells adjacent on the curve are visited as one range.
+ *
+ * @param[in]   oid     object id of the center
+ * @param[in]   visit   called with each range, the search stops if it returns false
+ */
+template <typename Visit>
+void GridIndex::Search(int oid, Visit visit) const {
+    int pos = rank_[oid];
+    int64_t col = Col(Coord(pos, 0));
+    int64_t row = sorted_.dims < 2 ? 0 : Row(Coord(pos, 1));
+    int64_t first_col = max(col - 1, (int64_t)0);
+    int64_t last_col = min(col + 1, num_cols_ - 1);
+
+    int range_begin = 0;
+    int range_end = 0;
+    for (int64_t r = max(row - 1, (int64_t)0); r <= min(row + 1, num_rows_ - 1); r++) {
+        for (int64_t c = first_col; c <= last_col; c++) {
+            int begin;
+            int end;
+            CellRange(c, r, begin, end);
+            if (begin == end) {
+                continue;
+            }
+            if (begin == range_end) {
+                range_end = end;
+                continue;
+            }
+            if (range_begin < range_end && visit(range_begin, range_end) == false) {
+                return;
+            }
+            range_begin = begin;
+            range_end = end;
+        }
+    }
+    if (range_begin < range_end) {
+        visit(range_begin, range_end);
+    }
+}
+
+/**
+ * Retrieve all objects within Eps from the object
+ *
+ * @param[in]   oid         object id of the center
+ * @param[out]  neighbors   object ids of the neighbors
+ */
+void GridIndex::RegionQuery(int oid, vector<int> &neighbors) const {
+    int pos = rank_[oid];
+    neighbors.clear();
+    Search(oid, [&](int begin, int end) {
+        int found = neighbors.size();
+        neighbors.resize(found + end - begin);
+        if (kernel_.single_precision) {
+            found += kernel_.scan_float(&sorted_float_[pos], &sorted_float_[begin], sorted_.Size(), sorted_.dims,
+                    &order_[begin], end - begin, kernel_.threshold, &neighbors[found]);
+        } else {
+            found += kernel_.scan(sorted_.Dim(0) + pos, sorted_.Dim(0) + begin, sorted_.Size(), sorted_.dims,
+                    &order_[begin], end - begin, kernel_.threshold, &neighbors[found]);
+        }
+        neighbors.resize(found);
+        return true;
+    });
+}
+
+/**
+ * Count the objects within Eps from the object up to the limit
+ *
+ * @param[in]   oid         object id of the center
+ * @param[in]   limit       count to stop at
+ * @return      number of the neighbors, at most limit
+ */
+int GridIndex::CountNeighbors(int oid, int limit) const {
+    int pos = rank_[oid];
+    int count = 0;
+    if (limit > 0) {
+        Search(oid, [&](int begin, int end) {
+            if (kernel_.single_precision) {
+                count += kernel_.count_float(&sorted_float_[pos], &sorted_float_[begin], sorted_.Size(),
+                        sorted_.dims, end - begin, kernel_.threshold, limit - count);
+            } else {
+                count += kernel_.count(sorted_.Dim(0) + pos, sorted_.Dim(0) + begin, sorted_.Size(),
+                        sorted_.dims, end - begin, kernel_.threshold, limit - count);
+            }
+            return count < limit;
+        });
+    }
+    return min(count, limit);
+}
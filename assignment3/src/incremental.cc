@@ -0,0 +1,222 @@
+/**
+ * Incremental DBSCAN keeping the clustering up to date while objects are inserted
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        incremental.cc
+ */
+
+#include "incremental.h"
+#include <cmath>
+#include <algorithm>
+
+IncrementalDBSCAN::IncrementalDBSCAN(const DistanceKernel &kernel, int min_pts)
+: kernel_(kernel), min_pts_(min_pts), side_(kernel.radius > 0 ? kernel.radius : 1.0) {}
+
+pair<int64_t, int64_t> IncrementalDBSCAN::CellKey(const double *point) const {
+    int64_t col = (int64_t)floor(point[0] / side_);
+    int64_t row = kernel_.dims < 2 ? 0 : (int64_t)floor(point[1] / side_);
+    return make_pair(col, row);
+}
+
+/**
+ * Insert a batch of objects, numbered after the objects inserted before
+ * The batch is inserted in chunks of INSERT_CHUNK objects, as if the chunks were given
+ * one after another, so the neighbors kept for a chunk are bounded.
+ * 1. Add the objects to the grid
+ * 2. Count the neighbors of each inserted object, and add it to the count of
+ *    each neighbor inserted before. An object whose count reaches MinPts becomes core.
+ * 3. Link each new core point with its core neighbors, and it becomes the core neighbor
+ *    of its other neighbors if it is smaller than theirs.
+ * 4. Each inserted object which is not core finds its smallest core neighbor.
+ * The objects whose type or smallest core neighbor changed are reported, and a set merged into
+ * another changes the cluster of its members without them being reported.
+ *
+ * @param[in]   points      coordinates of the inserted objects
+ * @param[out]  touched     inserted objects and objects whose type or core neighbor changed, ascending
+ * @param[out]  merged      (root, new root) of each set merged into another, in the order of the merges
+ */
+void IncrementalDBSCAN::Insert(const PointSet &points, vector<int> &touched, vector<pair<int, int>> &merged) {
+    int dims = kernel_.dims;
+    touched.clear();
+    merged.clear();
+    for (int begin = 0; begin < points.Size(); begin += INSERT_CHUNK) {
+        int end = min(begin + INSERT_CHUNK, points.Size());
+        int first = Size();
+        int size = end - begin;
+        coords_.resize((size_t)dims * (first + size));
+        count_.resize(first + size, 0);
+        first_core_.resize(first + size, -1);
+        for (int i = 0; i < size; i++) {
+            int oid = first + i;
+            double *point = &coords_[(size_t)dims * oid];
+            for (int d = 0; d < dims; d++) {
+                point[d] = points.At(begin + i, d);
+            }
+            parent_.push_back(oid);
+            touched.push_back(oid);
+
+            auto found = cell_of_key_.insert(make_pair(CellKey(point), (int)cells_.size()));
+            if (found.second) {
+                cells_.push_back(Cell());
+            }
+            Cell &cell = cells_[found.first->second];
+            cell.ids.push_back(oid);
+            cell.coords.insert(cell.coords.end(), point, point + dims);
+        }
+
+        vector<vector<int>> neighbors(size);
+        vector<int> new_cores;
+        for (int i = 0; i < size; i++) {
+            RegionQuery(first + i, neighbors[i]);
+            count_[first + i] = neighbors[i].size();
+            for (auto neighbor : neighbors[i]) {
+                // the count of an inserted neighbor is its own query
+                if (neighbor < first && ++count_[neighbor] == min_pts_) {
+                    new_cores.push_back(neighbor);
+                    touched.push_back(neighbor);
+                }
+            }
+        }
+        for (int i = 0; i < size; i++) {
+            if (IsCore(first + i)) {
+                new_cores.push_back(first + i);
+            }
+        }
+
+        vector<int> buffer;
+        for (auto core : new_cores) {
+            if (core < first) {
+                RegionQuery(core, buffer);
+            }
+            for (auto neighbor : core < first ? buffer : neighbors[core - first]) {
+                if (IsCore(neighbor)) {
+                    Union(core, neighbor, merged);
+                } else if (first_core_[neighbor] < 0 || core < first_core_[neighbor]) {
+                    first_core_[neighbor] = core;
+                    touched.push_back(neighbor);
+                }
+            }
+        }
+        for (int i = 0; i < size; i++) {
+            int oid = first + i;
+            if (IsCore(oid)) {
+                continue;
+            }
+            for (auto neighbor : neighbors[i]) {
+                if (IsCore(neighbor) && (first_core_[oid] < 0 || neighbor < first_core_[oid])) {
+                    first_core_[oid] = neighbor;
+                }
+            }
+        }
+    }
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+}
+
+/**
+ * Number the clusters and label every object
+ * An object which is not core joins the cluster of its smallest core neighbor, and the
+ * clusters are numbered in the order of their smallest member, the same as the
+ * clustering of all the objects at once.
+ *
+ * @param[out]  objects     type and cluster of every object, as many as inserted
+ * @return      number of the clusters
+ */
+int IncrementalDBSCAN::Label(vector<object> &objects) {
+    int size = Size();
+    vector<int> cluster_of_root(size, -1);
+    int num_clusters = 0;
+    for (int i = 0; i < size; i++) {
+        object &obj = objects[i];
+        obj.is_core = IsCore(i);
+        obj.type = Type(i);
+        int root = Cluster(i);
+        if (root < 0) {
+            obj.cluster_num = -1;
+            continue;
+        }
+        if (cluster_of_root[root] < 0) {
+            cluster_of_root[root] = num_clusters++;
+        }
+        obj.cluster_num = cluster_of_root[root];
+    }
+    return num_clusters;
+}
+
+/**
+ * Type of an object in the clustering so far
+ */
+ObjectType IncrementalDBSCAN::Type(int oid) const {
+    if (IsCore(oid)) {
+        return ObjectType::CORE;
+    }
+    return first_core_[oid] < 0 ? ObjectType::OUTLIER : ObjectType::BORDER;
+}
+
+/**
+ * Cluster of an object in the clustering so far, named by its smallest core point
+ *
+ * @param[in]   oid     object id
+ * @return      root of the set of the object or of its smallest core neighbor, -1 for an outlier
+ */
+int IncrementalDBSCAN::Cluster(int oid) {
+    if (IsCore(oid)) {
+        return Find(oid);
+    }
+    return first_core_[oid] < 0 ? -1 : Find(first_core_[oid]);
+}
+
+/**
+ * Retrieve all objects within Eps from the object in the 3x3 cells around it
+ *
+ * @param[in]   oid         object id of the center
+ * @param[out]  neighbors   object ids of the neighbors, the object itself included
+ */
+void IncrementalDBSCAN::RegionQuery(int oid, vector<int> &neighbors) const {
+    int dims = kernel_.dims;
+    const double *center = &coords_[(size_t)dims * oid];
+    pair<int64_t, int64_t> key = CellKey(center);
+    neighbors.clear();
+    for (int64_t row = key.second - 1; row <= key.second + 1; row++) {
+        for (int64_t col = key.first - 1; col <= key.first + 1; col++) {
+            auto found = cell_of_key_.find(make_pair(col, row));
+            if (found == cell_of_key_.end()) {
+                continue;
+            }
+            const Cell &cell = cells_[found->second];
+            for (size_t k = 0; k < cell.ids.size(); k++) {
+                if (kernel_.distance(center, &cell.coords[(size_t)dims * k], 1, dims) <= kernel_.threshold) {
+                    neighbors.push_back(cell.ids[k]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Find the root of the set, compressing the path by halving
+ */
+int IncrementalDBSCAN::Find(int x) {
+    while (parent_[x] != x) {
+        parent_[x] = parent_[parent_[x]];
+        x = parent_[x];
+    }
+    return x;
+}
+
+/**
+ * Unite two sets, the larger root is linked to the smaller one
+ *
+ * @param[in]   a           member of a set
+ * @param[in]   b           member of another set
+ * @param[out]  merged      (root, new root) appended if the sets were different
+ */
+void IncrementalDBSCAN::Union(int a, int b, vector<pair<int, int>> &merged) {
+    a = Find(a);
+    b = Find(b);
+    if (a != b) {
+        parent_[max(a, b)] = min(a, b);
+        merged.push_back(make_pair(max(a, b), min(a, b)));
+    }
+}
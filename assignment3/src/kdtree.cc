@@ -0,0 +1,240 @@
+/**
+ * k-d tree index for the region query of DBSCAN
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        kdtree.cc
+ */
+
+#include "kdtree.h"
+#include <algorithm>
+
+/**
+ * Bulk load the tree over all objects
+ * The coordinates are copied in the order of the leaves for the distance kernel
+ * In the float32 mode, the copy is kept only as float.
+ *
+ * @param[in]   points      coordinates of all input objects
+ * @param[in]   kernel      distance kernel for the metric and Eps
+ */
+KDTreeIndex::KDTreeIndex(const PointSet &points, const DistanceKernel &kernel)
+: kernel_(kernel) {
+    int size = points.Size();
+    order_.resize(size);
+    for (int i = 0; i < size; i++) {
+        order_[i] = i;
+    }
+    Build(points, 0, size, 0);
+
+    if (kernel.single_precision) {
+        sorted_.dims = points.dims;
+        sorted_.num_points = size;
+        sorted_float_ = points.ReorderFloat(order_);
+    } else {
+        sorted_ = points.Reorder(order_);
+    }
+    rank_.resize(size);
+    for (int i = 0; i < size; i++) {
+        rank_[order_[i]] = i;
+    }
+}
+
+/**
+ * Coordinate of the object at a position of order_, from the copy being scanned
+ */
+double KDTreeIndex::Coord(int pos, int d) const {
+    if (kernel_.single_precision) {
+        return sorted_float_[(size_t)d * sorted_.Size() + pos];
+    }
+    return sorted_.At(pos, d);
+}
+
+/**
+ * Build the subtree over order_[begin, end)
+ * The range is split at the median of the widest side of its bounding box
+ * In the float32 mode, the split is rounded to float, and rounding keeps the order,
+ * so each side still holds the rounded coordinates on its side of the split.
+ *
+ * @param[in]   points      coordinates of all objects
+ * @param[in]   begin, end  range of order_
+ * @param[in]   depth       depth of the node
+ * @return      index of the node
+ */
+int KDTreeIndex::Build(const PointSet &points, int begin, int end, int depth) {
+    int idx = nodes_.size();
+    nodes_.push_back(Node { begin, end, -1, -1, 0, 0.0 });
+    if (end - begin <= KD_LEAF_SIZE || depth + 1 >= KD_MAX_DEPTH) {
+        return idx;
+    }
+
+    int dim = 0;
+    double widest = -1.0;
+    for (int d = 0; d < points.dims; d++) {
+        const double *coords = points.Dim(d);
+        double low = coords[order_[begin]];
+        double high = low;
+        for (int i = begin; i < end; i++) {
+            low = min(low, coords[order_[i]]);
+            high = max(high, coords[order_[i]]);
+        }
+        if (high - low > widest) {
+            widest = high - low;
+            dim = d;
+        }
+    }
+
+    int mid = begin + (end - begin) / 2;
+    const double *coords = points.Dim(dim);
+    nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+            [&](int a, int b) {
+        return coords[a] < coords[b];
+    });
+
+    double split = coords[order_[mid]];
+    if (kernel_.single_precision) {
+        split = (float)split;
+    }
+    int left = Build(points, begin, mid, depth + 1);
+    int right = Build(points, mid, end, depth + 1);
+    nodes_[idx].left = left;
+    nodes_[idx].right = right;
+    nodes_[idx].dim = dim;
+    nodes_[idx].split = split;
+    return idx;
+}
+
+/**
+ * Visit the leaves which may have objects within Eps from the object
+ * The subtree on a side of the split is skipped if the center is farther than Eps from it
+ *
+ * @param[in]   oid     object id of the center
+ * @param[in]   visit   called with the range of each leaf, the search stops if it returns false
+ */
+template <typename Visit>
+void KDTreeIndex::Search(int oid, Visit visit) const {
+    if (nodes_.empty()) {
+        return;
+    }
+    int stack[KD_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes_[stack[--top]];
+        if (node.left < 0) {
+            if (visit(node.begin, node.end) == false) {
+                return;
+            }
+            continue;
+        }
+
+        double coord = Coord(rank_[oid], node.dim);
+        if (coord + kernel_.radius >= node.split) {
+            stack[top++] = node.right;
+        }
+        if (coord - kernel_.radius <= node.split) {
+            stack[top++] = node.left;
+        }
+    }
+}
+
+/**
+ * Retrieve all objects within Eps from the object
+ *
+ * @param[in]   oid         object id of the center
+ * @param[out]  neighbors   object ids of the neighbors
+ */
+void KDTreeIndex::RegionQuery(int oid, vector<int> &neighbors) const {
+    int pos = rank_[oid];
+    neighbors.clear();
+    Search(oid, [&](int begin, int end) {
+        int found = neighbors.size();
+        neighbors.resize(found + end - begin);
+        if (kernel_.single_precision) {
+            found += kernel_.scan_float(&sorted_float_[pos], &sorted_float_[begin], sorted_.Size(), sorted_.dims,
+                    &order_[begin], end - begin, kernel_.threshold, &neighbors[found]);
+        } else {
+            found += kernel_.scan(sorted_.Dim(0) + pos, sorted_.Dim(0) + begin, sorted_.Size(), sorted_.dims,
+                    &order_[begin], end - begin, kernel_.threshold, &neighbors[found]);
+        }
+        neighbors.resize(found);
+        return true;
+    });
+}
+
+/**
+ * Count the objects within Eps from the object up to the limit
+ *
+ * @param[in]   oid         object id of the center
+ * @param[in]   limit       count to stop at
+ * @return      number of the neighbors, at most limit
+ */
+int KDTreeIndex::CountNeighbors(int oid, int limit) const {
+    int pos = rank_[oid];
+    int count = 0;
+    if (limit > 0) {
+        Search(oid, [&](int begin, int end) {
+            if (kernel_.single_precision) {
+                count += kernel_.count_float(&sorted_float_[pos], &sorted_float_[begin], sorted_.Size(),
+                        sorted_.dims, end - begin, kernel_.threshold, limit - count);
+            } else {
+                count += kernel_.count(sorted_.Dim(0) + pos, sorted_.Dim(0) + begin, sorted_.Size(),
+                        sorted_.dims, end - begin, kernel_.threshold, limit - count);
+            }
+            return count < limit;
+        });
+    }
+    return min(count, limit);
+}
+
+/**
+ * Find the object nearest to a point by Euclidean distance
+ * A subtree is skipped if the distance to its side of the split is already farther
+ * than the nearest one. Among objects at the same distance, the smallest id is taken.
+ *
+ * @param[in]   point       coordinates of the point, point[d] for dimension d
+ * @return      object id of the nearest object, -1 if there is no object
+ */
+int KDTreeIndex::Nearest(const double *point) const {
+    int nearest = -1;
+    double nearest_dist = 0.0;
+    if (nodes_.empty()) {
+        return nearest;
+    }
+    int stack[KD_MAX_DEPTH + 1];
+    double bound[KD_MAX_DEPTH + 1]; // lower bound of the squared distance to the node
+    int top = 0;
+    stack[top] = 0;
+    bound[top++] = 0.0;
+    while (top > 0) {
+        top--;
+        const Node &node = nodes_[stack[top]];
+        double node_bound = bound[top];
+        if (nearest >= 0 && node_bound > nearest_dist) {
+            continue;
+        }
+        if (node.left < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                double dist = 0.0;
+                for (int d = 0; d < sorted_.dims; d++) {
+                    double diff = Coord(i, d) - point[d];
+                    dist += diff * diff;
+                }
+                if (nearest < 0 || dist < nearest_dist || (dist == nearest_dist && order_[i] < nearest)) {
+                    nearest = order_[i];
+                    nearest_dist = dist;
+                }
+            }
+            continue;
+        }
+
+        // the far side first, so the near side is searched first
+        double diff = point[node.dim] - node.split;
+        int near = diff <= 0 ? node.left : node.right;
+        int far = diff <= 0 ? node.right : node.left;
+        stack[top] = far;
+        bound[top++] = max(node_bound, diff * diff);
+        stack[top] = near;
+        bound[top++] = node_bound;
+    }
+    return nearest;
+}
@@ -0,0 +1,167 @@
+/**
+ * OPTICS ordering of the objects, from which DBSCAN clusterings are extracted
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        optics.cc
+ */
+
+#include "optics.h"
+#include <queue>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+
+Optics::Optics(const PointSet &points, const SpatialIndex &index, const DistanceKernel &kernel, int min_pts)
+: points_(points), index_(index), kernel_(kernel), min_pts_(min_pts) {}
+
+/**
+ * Query the neighbors of an object with their distances and get its core distance
+ *
+ * @param[in]   oid         object id
+ * @param[out]  neighbors   object ids of the neighbors within the generating distance
+ * @param[out]  dists       accumulated distance and object id of each neighbor, in any order
+ * @return      core distance, infinity if it has less than MinPts neighbors
+ */
+double Optics::Query(int oid, vector<int> &neighbors, vector<pair<double, int>> &dists) const {
+    index_.RegionQuery(oid, neighbors);
+    int size = points_.Size();
+    const double *center = points_.Dim(0) + oid;
+    dists.resize(neighbors.size());
+    for (size_t k = 0; k < neighbors.size(); k++) {
+        dists[k].first = kernel_.distance(center, points_.Dim(0) + neighbors[k], size, points_.dims);
+        dists[k].second = neighbors[k];
+    }
+    if (min_pts_ <= 0) {
+        return 0.0;
+    }
+    if ((int)dists.size() < min_pts_) {
+        return INFINITY;
+    }
+    // the MinPts-th smallest distance
+    nth_element(dists.begin(), dists.begin() + (min_pts_ - 1), dists.end());
+    return dists[min_pts_ - 1].first;
+}
+
+/**
+ * Record a core point reaching an object
+ * For an Eps, a border point joins its core neighbor with the smallest id. So a core is
+ * kept only if no core with a smaller id reaches the object within the same distance,
+ * and the cores with a larger id it reaches within a smaller distance are dropped.
+ *
+ * @param[in]   oid     object id
+ * @param[in]   core    object id of the core point
+ * @param[in]   dist    reachability distance of the object from the core point
+ */
+void Optics::Attach(int oid, int core, double dist) {
+    vector<pair<int, double>> &cores = attach_[oid];
+    auto pos = lower_bound(cores.begin(), cores.end(), make_pair(core, -(double)INFINITY));
+    if (pos != cores.begin() && prev(pos)->second <= dist) {
+        return;
+    }
+    auto last = pos;
+    while (last != cores.end() && last->second >= dist) {
+        last++;
+    }
+    pos = cores.erase(pos, last);
+    cores.insert(pos, make_pair(core, dist));
+}
+
+/**
+ * Order the objects
+ * Starting from the unordered object with the smallest id, the seeds reachable from
+ * the ordered core points are ordered by the smallest reachability distance first
+ * (the smaller id first among the same distance). Each object is queried once.
+ * Seeds are kept in a heap, and an entry whose reachability has been lowered since
+ * it was pushed is skipped when it is popped.
+ */
+void Optics::Run() {
+    int size = points_.Size();
+    order_.clear();
+    order_.reserve(size);
+    core_dist_.assign(size, INFINITY);
+    reach_.assign(size, INFINITY);
+    attach_.assign(size, vector<pair<int, double>>());
+
+    vector<bool> ordered(size, false);
+    vector<int> neighbors;
+    vector<pair<double, int>> dists;
+    priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> seeds;
+    for (int start = 0; start < size; start++) {
+        if (ordered[start]) {
+            continue;
+        }
+        seeds.push(make_pair(INFINITY, start));
+        while (!seeds.empty()) {
+            int p = seeds.top().second;
+            double reach = seeds.top().first;
+            seeds.pop();
+            if (ordered[p] || reach > reach_[p]) {
+                continue;
+            }
+            ordered[p] = true;
+            order_.push_back(p);
+
+            double core = Query(p, neighbors, dists);
+            core_dist_[p] = core;
+            if (std::isinf(core)) {
+                continue;
+            }
+            for (auto &neighbor : dists) {
+                int o = neighbor.second;
+                double dist = max(core, neighbor.first);
+                // every object within Eps of a core point is a border candidate
+                Attach(o, p, dist);
+                if (ordered[o] == false && dist < reach_[o]) {
+                    reach_[o] = dist;
+                    seeds.push(make_pair(dist, o));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Extract the DBSCAN clustering for an Eps up to the generating distance
+ * A core point for Eps has the core distance within Eps. Every cluster is a contiguous
+ * run of the ordering: a core point whose reachability is beyond Eps starts a new cluster,
+ * and the following core points reachable within Eps belong to it. A point which is not
+ * core joins the cluster of the core point with the smallest id reaching it within Eps,
+ * as DBSCAN assigns a border point, so it is a border point exactly when DBSCAN finds
+ * a core point within Eps.
+ *
+ * @param[in]   threshold   accumulated distance of Eps, a threshold of the kernel
+ * @param[out]  objects     type and cluster of every object
+ * @return      number of the clusters
+ */
+int Optics::Extract(double threshold, vector<object> &objects) const {
+    int num_clusters = 0;
+    for (auto p : order_) {
+        object &obj = objects[p];
+        obj.is_core = core_dist_[p] <= threshold;
+        obj.cluster_num = -1;
+        obj.type = ObjectType::OUTLIER;
+        if (obj.is_core) {
+            if (reach_[p] > threshold) {
+                num_clusters++;
+            }
+            obj.type = ObjectType::CORE;
+            obj.cluster_num = num_clusters - 1;
+        }
+    }
+    for (auto p : order_) {
+        object &obj = objects[p];
+        if (obj.is_core) {
+            continue;
+        }
+        // the first core within Eps has the smallest id
+        for (auto &core : attach_[p]) {
+            if (core.second <= threshold) {
+                obj.type = ObjectType::BORDER;
+                obj.cluster_num = objects[core.first].cluster_num;
+                break;
+            }
+        }
+    }
+    return num_clusters;
+}
@@ -0,0 +1,485 @@
+/**
+ * Loading the input points from a text or binary point file
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        pointfile.cc
+ */
+
+#include "pointfile.h"
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <thread>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TEXT_CHUNK_MIN (1 << 20) // smallest part of a text file parsed by a thread
+#define POINT_CHUNK (1 << 16) // points of a binary file read at once by Next
+
+// powers of ten exactly representable as double
+static const double g_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * Decode a decimal number, the same value as strtod
+ * A number of at most 19 significant digits is read into an integer mantissa. If the
+ * mantissa is below 2^53 and the exponent is within 22, both the mantissa and the power
+ * of ten are exact doubles, so one multiplication or division rounds correctly.
+ * Other numbers are passed to strtod.
+ *
+ * @param[in]   pos     first character of the number, moved past the number
+ * @param[in]   end     end of the text
+ * @param[out]  value   decoded number
+ * @return      whether a number was there
+ */
+static bool DecodeDouble(const char *&pos, const char *end, double &value) {
+    const char *p = pos;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int num_digits = 0; // significant digits read into the mantissa
+    int exponent = 0;
+    bool has_digit = false;
+    bool exact = true;
+    for (; p < end && IsDigit(*p); p++) {
+        has_digit = true;
+        if (num_digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            num_digits += mantissa != 0;
+        } else {
+            exact = false;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && IsDigit(*p); p++) {
+            has_digit = true;
+            if (num_digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                num_digits += mantissa != 0;
+                exponent--;
+            } else {
+                exact = false;
+            }
+        }
+    }
+    if (has_digit == false) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            q++;
+        }
+        if (q < end && IsDigit(*q)) {
+            int exp_value = 0;
+            for (; q < end && IsDigit(*q); q++) {
+                exp_value = min(exp_value * 10 + (*q - '0'), 100000);
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = q;
+        }
+    }
+
+    if (exact && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        value = exponent >= 0 ? (double)mantissa * g_pow10[exponent] : (double)mantissa / g_pow10[-exponent];
+        value = negative ? -value : value;
+    } else {
+        // the text may not be terminated, so the number is copied out
+        string number(pos, p);
+        value = strtod(number.c_str(), NULL);
+    }
+    pos = p;
+    return true;
+}
+
+/**
+ * Parse the lines of a part of the text: object id followed by the coordinates
+ * A line is invalid if it has no coordinate, a different number of coordinates or
+ * something other than a number.
+ *
+ * @param[in]   begin, end  part of the text, starting at a line
+ * @param[in]   dims        number of coordinates of every line
+ * @param[out]  rows        coordinates line by line
+ * @return      line in the part which is invalid (from 1), 0 if every line is valid
+ */
+static long ParseLines(const char *begin, const char *end, int dims, vector<double> &rows) {
+    long line = 0;
+    const char *p = begin;
+    while (p < end) {
+        line++;
+        int num_tokens = 0;
+        while (true) {
+            while (p < end && IsBlank(*p)) {
+                p++;
+            }
+            if (p == end || *p == '\n') {
+                break;
+            }
+            double value;
+            if (DecodeDouble(p, end, value) == false || (p < end && IsBlank(*p) == false && *p != '\n')) {
+                return line;
+            }
+            // the object id is not stored, objects are numbered by their line
+            if (num_tokens > 0) {
+                rows.push_back(value);
+            }
+            num_tokens++;
+        }
+        if (num_tokens == 1 || (num_tokens > 0 && num_tokens != dims + 1)) {
+            return line;
+        }
+        if (p < end) {
+            p++; // newline
+        }
+    }
+    return 0;
+}
+
+/**
+ * Number of coordinates from the first line which is not empty
+ *
+ * @param[in]   text, end   whole text
+ * @return      number of coordinates, 0 if there is none
+ */
+static int FirstLineDims(const char *text, const char *end) {
+    vector<double> first;
+    const char *line = text;
+    while (line < end && first.empty()) {
+        const char *line_end = (const char *)memchr(line, '\n', end - line);
+        line_end = line_end == NULL ? end : line_end;
+        ParseLines(line, line_end, INT_MAX - 1, first);
+        line = line_end < end ? line_end + 1 : end;
+    }
+    return first.size();
+}
+
+PointFile::~PointFile() {
+    Unmap();
+}
+
+void PointFile::Unmap() {
+    if (addr_ != NULL) {
+        munmap(addr_, size_);
+    }
+    addr_ = NULL;
+    size_ = 0;
+}
+
+/**
+ * Drop the mapped pages of a range read, so a file read chunk by chunk does not stay in memory
+ * The mapping is read only, so a page dropped by mistake is read from the file again.
+ *
+ * @param[in]   begin   first byte of the range
+ * @param[in]   end     byte after the range, the page holding it is kept
+ */
+void PointFile::Release(const void *begin, const void *end) const {
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)begin / page * page;
+    uintptr_t last = (uintptr_t)end / page * page;
+    if (first < last) {
+        madvise((void *)first, last - first, MADV_DONTNEED);
+    }
+}
+
+/**
+ * Map the point file and recognize a binary point file by its magic
+ *
+ * @param[in]   path            path of the point file
+ * @return      whether mapped or not, an empty file is not mapped
+ */
+bool PointFile::Map(const char *path) {
+    Unmap();
+    binary_ = false;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        error_ = "Can't open input data file.";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        error_ = "Can't open input data file.";
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        error_ = "Can't map input data file.";
+        return false;
+    }
+    addr_ = addr;
+    size_ = st.st_size;
+    madvise(addr_, size_, MADV_SEQUENTIAL);
+
+    binary_ = size_ >= sizeof(PointHeader)
+        && strncmp(((const PointHeader *)addr_)->magic, POINT_MAGIC, sizeof(PointHeader::magic)) == 0;
+    return true;
+}
+
+/**
+ * Map the point file and load the points from it
+ * A binary point file is recognized by its magic, any other file is parsed as text.
+ *
+ * @param[in]   path            path of the point file
+ * @param[out]  points          loaded points
+ * @param[in]   num_threads     threads parsing a text file
+ * @return      whether loaded or not, the reason is given by Error()
+ */
+bool PointFile::Load(const char *path, PointSet &points, int num_threads) {
+    points = PointSet();
+    if (Map(path) == false) {
+        return false;
+    }
+    if (addr_ == NULL) {
+        return true;
+    }
+    bool loaded = binary_ ? LoadBinary(points) : LoadText(points, num_threads);
+    if (binary_ == false || loaded == false) {
+        Unmap();
+    }
+    return loaded;
+}
+
+/**
+ * Use the coordinates of the mapped binary point file in place
+ *
+ * @param[out]  points      loaded points
+ * @return      whether the file is valid or not
+ */
+bool PointFile::LoadBinary(PointSet &points) {
+    const PointHeader *header = (const PointHeader *)addr_;
+    if (header->version != POINT_VERSION
+            || header->file_size != size_
+            || header->num_points > INT_MAX
+            || header->coord_offset % 8 != 0
+            || header->coord_offset < sizeof(PointHeader)
+            || header->coord_offset > size_
+            || (header->dims == 0 && header->num_points > 0)
+            || (header->num_points > 0
+                && header->dims > (size_ - header->coord_offset) / sizeof(double) / header->num_points)) {
+        error_ = "Invalid point file.";
+        return false;
+    }
+    points.dims = header->dims;
+    points.num_points = header->num_points;
+    points.mapped = (const double *)((const char *)addr_ + header->coord_offset);
+    return true;
+}
+
+/**
+ * Parse the mapped text, a line per object: object id followed by the coordinates
+ * The number of coordinates is taken from the first line. The text is split at lines
+ * into a part per thread, and the parsed parts are transposed into the point set.
+ *
+ * @param[out]  points          loaded points
+ * @param[in]   num_threads     threads parsing the text
+ * @return      whether every line is valid or not
+ */
+bool PointFile::LoadText(PointSet &points, int num_threads) {
+    const char *text = (const char *)addr_;
+    const char *end = text + size_;
+
+    int dims = FirstLineDims(text, end);
+
+    int num_parts = max(1, min(num_threads, (int)(size_ / TEXT_CHUNK_MIN)));
+    vector<const char *> part_begin(num_parts + 1, end);
+    part_begin[0] = text;
+    for (int t = 1; t < num_parts; t++) {
+        const char *pos = max(part_begin[t - 1], text + size_ / num_parts * t);
+        const char *newline = (const char *)memchr(pos, '\n', end - pos);
+        part_begin[t] = newline == NULL ? end : newline + 1;
+    }
+
+    vector<vector<double>> rows(num_parts);
+    vector<long> bad_lines(num_parts, 0);
+    auto parse = [&](int t) {
+        bad_lines[t] = ParseLines(part_begin[t], part_begin[t + 1], dims, rows[t]);
+    };
+    vector<thread> threads;
+    for (int t = 1; t < num_parts; t++) {
+        threads.push_back(thread(parse, t));
+    }
+    parse(0);
+    for (auto &worker : threads) {
+        worker.join();
+    }
+
+    for (int t = 0; t < num_parts; t++) {
+        if (bad_lines[t] > 0) {
+            long line = bad_lines[t] + count(text, part_begin[t], '\n');
+            error_ = "Invalid object at line " + to_string(line) + ".";
+            return false;
+        }
+    }
+
+    // transpose the parts into the arrays of the dimensions
+    vector<size_t> part_offset(num_parts + 1, 0);
+    for (int t = 0; t < num_parts; t++) {
+        part_offset[t + 1] = part_offset[t] + (dims > 0 ? rows[t].size() / dims : 0);
+    }
+    if (part_offset[num_parts] > INT_MAX) {
+        error_ = "Too many objects in input data file.";
+        return false;
+    }
+    points.dims = dims;
+    points.num_points = part_offset[num_parts];
+    points.coords.resize((size_t)dims * points.num_points);
+    auto transpose = [&](int t) {
+        size_t num_rows = part_offset[t + 1] - part_offset[t];
+        for (int d = 0; d < dims; d++) {
+            double *dst = points.coords.data() + (size_t)d * points.num_points + part_offset[t];
+            for (size_t i = 0; i < num_rows; i++) {
+                dst[i] = rows[t][i * dims + d];
+            }
+        }
+        vector<double>().swap(rows[t]);
+    };
+    threads.clear();
+    for (int t = 1; t < num_parts; t++) {
+        threads.push_back(thread(transpose, t));
+    }
+    transpose(0);
+    for (auto &worker : threads) {
+        worker.join();
+    }
+    return true;
+}
+
+/**
+ * Map the point file to read the points chunk by chunk with Next
+ *
+ * @param[in]   path        path of the point file
+ * @return      whether opened or not, the reason is given by Error()
+ */
+bool PointFile::Open(const char *path) {
+    stream_ = PointSet();
+    dims_ = 0;
+    cursor_ = 0;
+    line_ = 0;
+    if (Map(path) == false) {
+        return false;
+    }
+    if (addr_ == NULL) {
+        return true;
+    }
+    if (binary_) {
+        if (LoadBinary(stream_) == false) {
+            Unmap();
+            return false;
+        }
+        dims_ = stream_.dims;
+    } else {
+        dims_ = FirstLineDims((const char *)addr_, (const char *)addr_ + size_);
+    }
+    return true;
+}
+
+/**
+ * Read the next chunk of the opened point file, the objects follow the previous chunk
+ * A chunk of a text file is about TEXT_CHUNK_MIN bytes of lines, and a chunk of
+ * a binary file is POINT_CHUNK points.
+ *
+ * @param[out]  points      points of the chunk
+ * @return      false at the end of the file or if a line is invalid (given by Error())
+ */
+bool PointFile::Next(PointSet &points) {
+    points = PointSet();
+    points.dims = dims_;
+    if (binary_) {
+        if (cursor_ >= (size_t)stream_.Size()) {
+            return false;
+        }
+        int num_points = min((size_t)POINT_CHUNK, stream_.Size() - cursor_);
+        points.num_points = num_points;
+        points.coords.resize((size_t)dims_ * num_points);
+        for (int d = 0; d < dims_; d++) {
+            const double *src = stream_.Dim(d) + cursor_;
+            copy(src, src + num_points, points.coords.begin() + (size_t)d * num_points);
+            Release(src, src + num_points);
+        }
+        cursor_ += num_points;
+        return true;
+    }
+
+    const char *text = (const char *)addr_;
+    if (cursor_ >= size_) {
+        return false;
+    }
+    const char *begin = text + cursor_;
+    const char *end = text + min(size_, cursor_ + TEXT_CHUNK_MIN);
+    const char *newline = (const char *)memchr(end - 1, '\n', text + size_ - (end - 1));
+    end = newline == NULL ? text + size_ : newline + 1;
+
+    vector<double> rows;
+    long bad_line = ParseLines(begin, end, dims_, rows);
+    if (bad_line > 0) {
+        error_ = "Invalid object at line " + to_string(line_ + bad_line) + ".";
+        return false;
+    }
+    line_ += count(begin, end, '\n');
+    cursor_ = end - text;
+    Release(begin, end);
+
+    int num_points = dims_ > 0 ? rows.size() / dims_ : 0;
+    points.num_points = num_points;
+    points.coords.resize(rows.size());
+    for (int d = 0; d < dims_; d++) {
+        for (int i = 0; i < num_points; i++) {
+            points.coords[(size_t)d * num_points + i] = rows[(size_t)i * dims_ + d];
+        }
+    }
+    return true;
+}
+
+/**
+ * Save the points as a binary point file
+ *
+ * @param[in]   path        path of the point file
+ * @param[in]   points      points to be saved
+ * @return      whether saved or not
+ */
+bool SavePoints(const char *path, const PointSet &points) {
+    PointHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, POINT_MAGIC, sizeof(header.magic));
+    header.version = POINT_VERSION;
+    header.dims = points.dims;
+    header.num_points = points.Size();
+    header.coord_offset = (sizeof(PointHeader) + 7) & ~(size_t)7;
+    header.file_size = header.coord_offset + sizeof(double) * (uint64_t)points.dims * points.Size();
+
+    ofstream fs_points(path, ofstream::out | ofstream::binary);
+    if (fs_points.is_open() == false) {
+        return false;
+    }
+    string padding(header.coord_offset - sizeof(header), '\0');
+    fs_points.write((const char *)&header, sizeof(header));
+    fs_points.write(padding.data(), padding.size());
+    fs_points.write((const char *)points.Data(), sizeof(double) * (size_t)points.dims * points.Size());
+    return fs_points.good();
+}
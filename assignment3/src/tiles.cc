@@ -0,0 +1,658 @@
+/**
+ * Out-of-core DBSCAN clustering the objects tile by tile
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        tiles.cc
+ */
+
+#include "tiles.h"
+#include "grid.h"
+#include "kdtree.h"
+#include "parallel.h"
+#include "pointfile.h"
+#include "writer.h"
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+
+#define TILE_WRITERS 64 // tile files written in a pass over the input
+#define TILE_WRITER_MIN_BUFFER (1 << 12) // smallest buffer of a tile file
+
+// region of an object in a tile
+#define TILE_HALO 0 // only a neighbor of the ring, its core status is unknown
+#define TILE_RING 1 // within Eps of the tile, its core status is exact
+#define TILE_OWNED 2 // owned by the tile
+
+TiledDBSCAN::TiledDBSCAN(Metric metric, double eps, int min_pts, IndexType index, int tile_size,
+        const string &work_path)
+: metric_(metric), eps_(eps), min_pts_(min_pts), index_(index), tile_size_(max(tile_size, 1)),
+  work_path_(work_path), halo_(0.0), dims_(0), num_points_(0) {}
+
+TiledDBSCAN::~TiledDBSCAN() {
+    RemoveFiles();
+}
+
+string TiledDBSCAN::TilePath(int tile) const {
+    return work_path_ + "_tile_" + to_string(tile) + ".tmp";
+}
+
+string TiledDBSCAN::ResultPath(int tile) const {
+    return work_path_ + "_result_" + to_string(tile) + ".tmp";
+}
+
+string TiledDBSCAN::RangePath(int range) const {
+    return work_path_ + "_range_" + to_string(range) + ".tmp";
+}
+
+void TiledDBSCAN::RemoveFiles() const {
+    for (int t = 0; t < NumTiles(); t++) {
+        remove(TilePath(t).c_str());
+        remove(ResultPath(t).c_str());
+    }
+    for (int r = 0; r < NumRanges(); r++) {
+        remove(RangePath(r).c_str());
+    }
+}
+
+/**
+ * Get the buffer of each of the files written together, TILE_WRITERS at most,
+ * so the buffers hold about as many bytes as the records of a tile
+ *
+ * @param[in]   record  bytes of a record of the files
+ * @return      bytes of the buffer of a file
+ */
+size_t TiledDBSCAN::BufferSize(size_t record) const {
+    size_t buffer_size = (size_t)tile_size_ * record / TILE_WRITERS;
+    return max((size_t)TILE_WRITER_MIN_BUFFER, min(buffer_size, (size_t)WRITER_BUFFER_SIZE));
+}
+
+/**
+ * Get the points the tiles are laid over
+ *
+ * @param[in]   points      coordinates of the objects
+ * @param[out]  normalized  unit length coordinates for the cosine metric
+ * @return      normalized points for the cosine metric, otherwise the points
+ */
+static const PointSet &IndexedPoints(Metric metric, const PointSet &points, PointSet &normalized) {
+    if (metric != Metric::COSINE) {
+        return points;
+    }
+    normalized = NormalizePoints(points);
+    return normalized;
+}
+
+/**
+ * Place the tiles and write the objects of each tile into its file
+ * The input is read three times: for the number of objects and the range of the split
+ * coordinates, for their histogram, and for writing the tiles.
+ * A tile file holds the objects within twice the halo from the tile, an object after
+ * another: object id as int32 and the coordinates as doubles.
+ *
+ * @param[in]   path    path of the input file
+ * @return      whether partitioned or not, the reason is given by Error()
+ */
+bool TiledDBSCAN::Partition(const char *path) {
+    PointFile input;
+    PointSet chunk;
+    PointSet normalized;
+
+    if (input.Open(path) == false) {
+        error_ = input.Error();
+        return false;
+    }
+    dims_ = input.Dims();
+    split_dims_ = min(dims_, 2);
+    kernel_ = MakeDistanceKernel(dims_, metric_, eps_);
+    halo_ = kernel_.radius * (1.0 + TILE_MARGIN);
+    double min_x[2] = {INFINITY, INFINITY};
+    double max_x[2] = {-INFINITY, -INFINITY};
+    long num_points = 0;
+    while (input.Next(chunk)) {
+        const PointSet &indexed = IndexedPoints(metric_, chunk, normalized);
+        for (int d = 0; d < split_dims_; d++) {
+            const double *xs = indexed.Dim(d);
+            for (int i = 0; i < indexed.Size(); i++) {
+                min_x[d] = min(min_x[d], xs[i]);
+                max_x[d] = max(max_x[d], xs[i]);
+            }
+        }
+        num_points += chunk.Size();
+    }
+    if (input.Error().empty() == false) {
+        error_ = input.Error();
+        return false;
+    }
+    if (num_points > INT_MAX) {
+        error_ = "Too many objects in input data file.";
+        return false;
+    }
+    num_points_ = num_points;
+    if (kernel_.single_precision) {
+        // neighbors are found by the rounded coordinates, which differ by the rounding of each
+        for (int d = 0; d < split_dims_; d++) {
+            halo_ += 2 * max(fabs(min_x[d]), fabs(max_x[d])) * FLT_EPSILON;
+        }
+    }
+
+    // histogram of the split coordinates, summed into a table of the objects below and left of each bin
+    int bins[2] = {1, 1};
+    double width[2] = {0.0, 0.0};
+    for (int d = 0; d < split_dims_; d++) {
+        bins[d] = (int)round(pow(TILE_BINS, 1.0 / split_dims_));
+        width[d] = num_points > 0 ? max_x[d] - min_x[d] : 0.0;
+    }
+    vector<long> table((size_t)(bins[0] + 1) * (bins[1] + 1), 0);
+    input.Open(path);
+    while (input.Next(chunk)) {
+        const PointSet &indexed = IndexedPoints(metric_, chunk, normalized);
+        for (int i = 0; i < indexed.Size(); i++) {
+            int bin[2] = {0, 0};
+            for (int d = 0; d < split_dims_; d++) {
+                int b = width[d] > 0 ? (int)((indexed.At(i, d) - min_x[d]) / width[d] * bins[d]) : 0;
+                bin[d] = max(0, min(b, bins[d] - 1));
+            }
+            table[(size_t)(bin[1] + 1) * (bins[0] + 1) + bin[0] + 1]++;
+        }
+    }
+    for (int y = 1; y <= bins[1]; y++) {
+        for (int x = 1; x <= bins[0]; x++) {
+            size_t at = (size_t)y * (bins[0] + 1) + x;
+            table[at] += table[at - 1] + table[at - (bins[0] + 1)] - table[at - (bins[0] + 1) - 1];
+        }
+    }
+    tiles_.clear();
+    nodes_.clear();
+    int lo[2] = {0, 0};
+    int hi[2] = {bins[0], bins[1]};
+    SplitTiles(table, bins, min_x, width, lo, hi);
+    vector<long>().swap(table);
+
+    // a group of tiles is written in a pass over the input
+    size_t buffer_size = BufferSize(sizeof(int32_t) + sizeof(double) * dims_);
+    vector<int> near;
+    for (int group = 0; group < NumTiles(); group += TILE_WRITERS) {
+        int group_end = min(group + TILE_WRITERS, NumTiles());
+        vector<BufferedWriter> writers(group_end - group);
+        for (int t = group; t < group_end; t++) {
+            if (writers[t - group].Open(TilePath(t), buffer_size) == false) {
+                error_ = "Can't open tile file.";
+                return false;
+            }
+        }
+        input.Open(path);
+        int oid = 0;
+        while (input.Next(chunk)) {
+            const PointSet &indexed = IndexedPoints(metric_, chunk, normalized);
+            for (int i = 0; i < chunk.Size(); i++, oid++) {
+                double x[2] = {0.0, 0.0};
+                for (int d = 0; d < split_dims_; d++) {
+                    x[d] = indexed.At(i, d);
+                }
+                near.clear();
+                TilesNear(0, x, 2 * halo_, near);
+                for (auto t : near) {
+                    if (t < group || t >= group_end) {
+                        continue;
+                    }
+                    BufferedWriter &writer = writers[t - group];
+                    int32_t id = oid;
+                    writer.Write((const char *)&id, sizeof(id));
+                    for (int d = 0; d < dims_; d++) {
+                        double coord = chunk.At(i, d);
+                        writer.Write((const char *)&coord, sizeof(coord));
+                    }
+                }
+            }
+        }
+        for (auto &writer : writers) {
+            if (writer.Close() == false) {
+                error_ = "Can't write tile file.";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Split a range of the histogram into tiles of about tile_size_ objects
+ * The range is split along its longer side, so that each side gets its share of the tiles.
+ * A side narrower than TILE_MIN_SIDE halos is not split, and a range which cannot be split
+ * on any dimension becomes a tile even if it holds more objects.
+ *
+ * @param[in]   table   objects below and left of each bin, (bins[0] + 1) per row
+ * @param[in]   bins    bins of each dimension
+ * @param[in]   min_x   smallest coordinate of each dimension
+ * @param[in]   width   range of the coordinates of each dimension
+ * @param[in]   lo      first bin of the range in each dimension
+ * @param[in]   hi      end bin of the range in each dimension
+ * @return      node of the range
+ */
+int TiledDBSCAN::SplitTiles(const vector<long> &table, const int *bins, const double *min_x, const double *width,
+        int *lo, int *hi) {
+    auto count = [&](const int *l, const int *h) {
+        size_t row = bins[0] + 1;
+        return table[h[1] * row + h[0]] - table[l[1] * row + h[0]] - table[h[1] * row + l[0]] + table[l[1] * row + l[0]];
+    };
+    auto bound = [&](int d, int b) {
+        return b == 0 ? -INFINITY : b == bins[d] ? INFINITY : min_x[d] + width[d] * b / bins[d];
+    };
+    long total = count(lo, hi);
+    long num_tiles = (total + tile_size_ - 1) / tile_size_;
+
+    // the longer side is tried first
+    int dims[2] = {0, 1};
+    if (split_dims_ == 2 && (hi[1] - lo[1]) * width[1] / bins[1] > (hi[0] - lo[0]) * width[0] / bins[0]) {
+        swap(dims[0], dims[1]);
+    }
+    for (int k = 0; k < split_dims_ && num_tiles > 1; k++) {
+        int d = dims[k];
+        if (width[d] <= 0) {
+            continue;
+        }
+        // bins of the narrowest side, and the objects of the left side
+        double min_bins = ceil(TILE_MIN_SIDE * halo_ / (width[d] / bins[d]));
+        int margin = (int)max(1.0, min(min_bins, (double)bins[d]));
+        long target = total * (num_tiles / 2) / num_tiles;
+        int split_hi[2] = {hi[0], hi[1]};
+        int split = lo[d] + margin;
+        for (; split < hi[d] - margin; split++) {
+            split_hi[d] = split;
+            if (count(lo, split_hi) >= target) {
+                break;
+            }
+        }
+        split_hi[d] = split;
+        if (split > hi[d] - margin || count(lo, split_hi) == 0 || count(lo, split_hi) == total) {
+            continue;
+        }
+
+        int node = nodes_.size();
+        nodes_.push_back(TileNode{d, bound(d, split), -1, -1});
+        int left_hi[2] = {hi[0], hi[1]};
+        int right_lo[2] = {lo[0], lo[1]};
+        left_hi[d] = split;
+        right_lo[d] = split;
+        int left = SplitTiles(table, bins, min_x, width, lo, left_hi);
+        int right = SplitTiles(table, bins, min_x, width, right_lo, hi);
+        nodes_[node].left = left;
+        nodes_[node].right = right;
+        return node;
+    }
+
+    TileRect rect;
+    for (int d = 0; d < 2; d++) {
+        rect.lo[d] = d < split_dims_ ? bound(d, lo[d]) : -INFINITY;
+        rect.hi[d] = d < split_dims_ ? bound(d, hi[d]) : INFINITY;
+    }
+    nodes_.push_back(TileNode{-1, 0.0, (int)tiles_.size(), -1});
+    tiles_.push_back(rect);
+    return nodes_.size() - 1;
+}
+
+/**
+ * Tiles whose rectangle widened by a margin holds a point
+ *
+ * @param[in]   node    node of the tree searched
+ * @param[in]   x       split coordinates of the point
+ * @param[in]   margin  width added to every side of the rectangles
+ * @param[out]  tiles   tiles found, appended
+ */
+void TiledDBSCAN::TilesNear(int node, const double *x, double margin, vector<int> &tiles) const {
+    const TileNode &split = nodes_[node];
+    if (split.dim < 0) {
+        tiles.push_back(split.left);
+        return;
+    }
+    if (x[split.dim] <= split.split + margin) {
+        TilesNear(split.left, x, margin, tiles);
+    }
+    if (x[split.dim] >= split.split - margin) {
+        TilesNear(split.right, x, margin, tiles);
+    }
+}
+
+SpatialIndex *TiledDBSCAN::BuildIndex(const PointSet &points) const {
+    if (index_ == IndexType::BRUTE_FORCE) {
+        return new BruteForceIndex(points, kernel_);
+    } else if (index_ == IndexType::KD_TREE) {
+        return new KDTreeIndex(points, kernel_);
+    }
+    return new GridIndex(points, kernel_);
+}
+
+/**
+ * Cluster every tile and merge the local clusters sharing a core point
+ * Each local cluster is a node, the nodes are merged with union-find and the clusters
+ * are numbered by their smallest member.
+ *
+ * @return      whether clustered or not, the reason is given by Error()
+ */
+bool TiledDBSCAN::Cluster() {
+    vector<pair<int, int>> ring_cores; // (object id, node) of the cores in the ring of a tile
+    vector<pair<int, int>> edge_cores; // (object id, node) of the owned cores near the boundaries
+    vector<int> node_min_oid;
+    vector<int> node_size;
+    vector<double> node_sums;
+    for (int t = 0; t < NumTiles(); t++) {
+        if (ClusterTile(t, ring_cores, edge_cores, node_min_oid, node_size, node_sums) == false) {
+            return false;
+        }
+    }
+
+    // a core point in the ring of a tile is owned by another tile near its boundary
+    int num_nodes = node_min_oid.size();
+    UnionFind nodes(num_nodes);
+    sort(edge_cores.begin(), edge_cores.end());
+    for (auto &core : ring_cores) {
+        auto owner = lower_bound(edge_cores.begin(), edge_cores.end(), make_pair(core.first, INT_MIN));
+        if (owner != edge_cores.end() && owner->first == core.first) {
+            nodes.Union(core.second, owner->second);
+        }
+    }
+
+    vector<int> min_oid(num_nodes, INT_MAX);
+    for (int node = 0; node < num_nodes; node++) {
+        int root = nodes.Find(node);
+        min_oid[root] = min(min_oid[root], node_min_oid[node]);
+    }
+    vector<int> roots;
+    for (int node = 0; node < num_nodes; node++) {
+        if (nodes.Find(node) == node) {
+            roots.push_back(node);
+        }
+    }
+    sort(roots.begin(), roots.end(), [&](int a, int b) {
+        return min_oid[a] < min_oid[b];
+    });
+    vector<int> cluster_of_root(num_nodes, -1);
+    for (size_t c = 0; c < roots.size(); c++) {
+        cluster_of_root[roots[c]] = c;
+    }
+
+    cluster_of_node_.resize(num_nodes);
+    cluster_size_.assign(roots.size(), 0);
+    cluster_sums_.assign(roots.size() * dims_, 0.0);
+    for (int node = 0; node < num_nodes; node++) {
+        int cluster = cluster_of_root[nodes.Find(node)];
+        cluster_of_node_[node] = cluster;
+        cluster_size_[cluster] += node_size[node];
+        for (int d = 0; d < dims_; d++) {
+            cluster_sums_[(size_t)cluster * dims_ + d] += node_sums[(size_t)node * dims_ + d];
+        }
+    }
+    return true;
+}
+
+/**
+ * Load a tile and cluster the objects within Eps of it
+ * The result of each owned object is written to the result file of the tile,
+ * with the node of its local cluster as the cluster.
+ *
+ * @param[in]   tile            tile number
+ * @param[out]  ring_cores      (object id, node) of the cores in the ring, appended
+ * @param[out]  edge_cores      (object id, node) of the owned cores within Eps of the boundaries, appended
+ * @param[out]  node_min_oid    smallest member of each node, appended
+ * @param[out]  node_size       owned objects of each node, appended
+ * @param[out]  node_sums       sum of the coordinates of the owned objects of each node, appended
+ * @return      whether clustered or not
+ */
+bool TiledDBSCAN::ClusterTile(int tile, vector<pair<int, int>> &ring_cores, vector<pair<int, int>> &edge_cores,
+        vector<int> &node_min_oid, vector<int> &node_size, vector<double> &node_sums) {
+    // the records are read a block at a time straight into the points
+    ifstream fs_tile(TilePath(tile), ifstream::in | ifstream::binary | ifstream::ate);
+    if (fs_tile.is_open() == false) {
+        error_ = "Can't open tile file.";
+        return false;
+    }
+    size_t record = sizeof(int32_t) + sizeof(double) * dims_;
+    int size = (size_t)fs_tile.tellg() / record;
+    fs_tile.seekg(0);
+    PointSet points;
+    points.dims = dims_;
+    points.num_points = size;
+    points.coords.resize((size_t)dims_ * size);
+    vector<int> oids(size);
+    vector<char> block(record * TILE_READ_RECORDS);
+    for (int begin = 0; begin < size; begin += TILE_READ_RECORDS) {
+        int end = min(begin + TILE_READ_RECORDS, size);
+        if (fs_tile.read(block.data(), record * (end - begin)).fail()) {
+            error_ = "Can't read tile file.";
+            return false;
+        }
+        for (int i = begin; i < end; i++) {
+            const char *p = &block[(i - begin) * record];
+            int32_t oid;
+            memcpy(&oid, p, sizeof(oid));
+            oids[i] = oid;
+            for (int d = 0; d < dims_; d++) {
+                memcpy(&points.coords[(size_t)d * size + i], p + sizeof(oid) + sizeof(double) * d, sizeof(double));
+            }
+        }
+    }
+    fs_tile.close();
+    vector<char>().swap(block);
+    remove(TilePath(tile).c_str());
+    PointSet normalized;
+    const PointSet &indexed = IndexedPoints(metric_, points, normalized);
+
+    // owned inside the rectangle, ring within the halo of it, and near an edge within the halo inside it
+    const TileRect &rect = tiles_[tile];
+    auto inside = [&](int i, double margin) {
+        for (int d = 0; d < split_dims_; d++) {
+            double x = indexed.At(i, d);
+            if (x < rect.lo[d] - margin || x >= rect.hi[d] + margin) {
+                return false;
+            }
+        }
+        return true;
+    };
+    vector<char> region(size, TILE_HALO);
+    for (int i = 0; i < size; i++) {
+        if (inside(i, 0.0)) {
+            region[i] = TILE_OWNED;
+        } else if (inside(i, halo_)) {
+            region[i] = TILE_RING;
+        }
+    }
+
+    // the ring and the owned objects have every neighbor in the tile
+    SpatialIndex *index = BuildIndex(indexed);
+    vector<bool> core(size, false);
+    for (int i = 0; i < size; i++) {
+        if (region[i] != TILE_HALO) {
+            core[i] = index->CountNeighbors(i, min_pts_) >= min_pts_;
+        }
+    }
+    UnionFind core_sets(size);
+    vector<int> neighbors;
+    for (int i = 0; i < size; i++) {
+        if (core[i] == false) {
+            continue;
+        }
+        index->RegionQuery(i, neighbors);
+        for (auto neighbor : neighbors) {
+            if (neighbor < i && core[neighbor]) {
+                core_sets.Union(i, neighbor);
+            }
+        }
+    }
+
+    vector<int> node_of_root(size, -1);
+    vector<int> node_of(size, -1);
+    for (int i = 0; i < size; i++) {
+        if (core[i] == false) {
+            continue;
+        }
+        int root = core_sets.Find(i);
+        if (node_of_root[root] < 0) {
+            node_of_root[root] = node_min_oid.size();
+            node_min_oid.push_back(INT_MAX);
+            node_size.push_back(0);
+            node_sums.resize(node_sums.size() + dims_, 0.0);
+        }
+        int node = node_of_root[root];
+        node_of[i] = node;
+        node_min_oid[node] = min(node_min_oid[node], oids[i]);
+        if (region[i] == TILE_RING) {
+            ring_cores.push_back(make_pair(oids[i], node));
+        } else if (inside(i, -halo_) == false) {
+            edge_cores.push_back(make_pair(oids[i], node));
+        }
+    }
+
+    BufferedWriter fs_result;
+    if (fs_result.Open(ResultPath(tile)) == false) {
+        delete index;
+        error_ = "Can't open tile file.";
+        return false;
+    }
+    for (int i = 0; i < size; i++) {
+        if (region[i] != TILE_OWNED) {
+            continue;
+        }
+        TileLabel label;
+        label.oid = oids[i];
+        label.cluster = node_of[i];
+        label.type = (int32_t)ObjectType::CORE;
+        if (core[i] == false) {
+            // a border point joins the local cluster of its smallest core neighbor
+            int first_core = -1;
+            index->RegionQuery(i, neighbors);
+            for (auto neighbor : neighbors) {
+                if (core[neighbor] && (first_core < 0 || oids[neighbor] < oids[first_core])) {
+                    first_core = neighbor;
+                }
+            }
+            label.cluster = first_core < 0 ? -1 : node_of[first_core];
+            label.type = (int32_t)(first_core < 0 ? ObjectType::OUTLIER : ObjectType::BORDER);
+            if (first_core >= 0) {
+                node_min_oid[label.cluster] = min(node_min_oid[label.cluster], oids[i]);
+            }
+        }
+        if (label.cluster >= 0) {
+            node_size[label.cluster]++;
+            for (int d = 0; d < dims_; d++) {
+                node_sums[(size_t)label.cluster * dims_ + d] += points.At(i, d);
+            }
+        }
+        fs_result.Write((const char *)&label, sizeof(label));
+    }
+    delete index;
+    if (fs_result.Close() == false) {
+        error_ = "Can't write tile file.";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Centroid of each cluster
+ *
+ * @return      centroids, the point c is the centroid of the cluster c
+ */
+PointSet TiledDBSCAN::Centroids() const {
+    PointSet centroids;
+    centroids.dims = dims_;
+    centroids.num_points = NumClusters();
+    centroids.coords.resize((size_t)dims_ * NumClusters());
+    for (int c = 0; c < NumClusters(); c++) {
+        for (int d = 0; d < dims_; d++) {
+            centroids.coords[(size_t)d * NumClusters() + c] = cluster_sums_[(size_t)c * dims_ + d] / cluster_size_[c];
+        }
+    }
+    return centroids;
+}
+
+/**
+ * Write the label file, a TileLabel per object in the order of the object ids
+ * The results of the tiles are split by the object ids into range files of tile_size_
+ * objects, a group of ranges in a pass over the result files. Each range file is loaded
+ * and written to the label file in order, so the labels are not held in memory.
+ *
+ * @param[in]   label_of_cluster    label printed for each cluster
+ * @param[in]   path                path of the label file
+ * @return      whether written or not, the reason is given by Error()
+ */
+bool TiledDBSCAN::Label(const vector<int> &label_of_cluster, const string &path) {
+    BufferedWriter fs_labels;
+    if (fs_labels.Open(path) == false) {
+        error_ = "Can't open output data file.";
+        return false;
+    }
+    size_t buffer_size = BufferSize(sizeof(TileLabel));
+    vector<TileLabel> results(TILE_READ_RECORDS);
+    vector<TileLabel> labels;
+    for (int group = 0; group < NumRanges(); group += TILE_WRITERS) {
+        int group_end = min(group + TILE_WRITERS, NumRanges());
+        vector<BufferedWriter> writers(group_end - group);
+        for (int r = group; r < group_end; r++) {
+            if (writers[r - group].Open(RangePath(r), buffer_size) == false) {
+                error_ = "Can't open range file.";
+                return false;
+            }
+        }
+        for (int t = 0; t < NumTiles(); t++) {
+            ifstream fs_result(ResultPath(t), ifstream::in | ifstream::binary);
+            if (fs_result.is_open() == false) {
+                error_ = "Can't open result file.";
+                return false;
+            }
+            while (fs_result) {
+                fs_result.read((char *)results.data(), sizeof(TileLabel) * results.size());
+                int count = fs_result.gcount() / sizeof(TileLabel);
+                for (int i = 0; i < count; i++) {
+                    TileLabel &result = results[i];
+                    int range = result.oid / tile_size_;
+                    if (range < group || range >= group_end) {
+                        continue;
+                    }
+                    if (result.cluster >= 0) {
+                        result.cluster = label_of_cluster[cluster_of_node_[result.cluster]];
+                    }
+                    writers[range - group].Write((const char *)&result, sizeof(result));
+                }
+            }
+        }
+        for (auto &writer : writers) {
+            if (writer.Close() == false) {
+                error_ = "Can't write range file.";
+                return false;
+            }
+        }
+
+        // every object of a range is in its file once
+        for (int r = group; r < group_end; r++) {
+            int begin = r * tile_size_;
+            labels.resize(min(tile_size_, num_points_ - begin));
+            ifstream fs_range(RangePath(r), ifstream::in | ifstream::binary);
+            if (fs_range.is_open() == false) {
+                error_ = "Can't open range file.";
+                return false;
+            }
+            while (fs_range) {
+                fs_range.read((char *)results.data(), sizeof(TileLabel) * results.size());
+                int count = fs_range.gcount() / sizeof(TileLabel);
+                for (int i = 0; i < count; i++) {
+                    labels[results[i].oid - begin] = results[i];
+                }
+            }
+            fs_range.close();
+            remove(RangePath(r).c_str());
+            fs_labels.Write((const char *)labels.data(), sizeof(TileLabel) * labels.size());
+        }
+    }
+    for (int t = 0; t < NumTiles(); t++) {
+        remove(ResultPath(t).c_str());
+    }
+    if (fs_labels.Close() == false) {
+        error_ = "Can't write output data file.";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+/**
+ * Buffered writer of the output files
+ *
+ * @author      Kwangil Cho
+ * @since       2017-05-03
+ * @file        writer.cc
+ */
+
+#include "writer.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * Open the output file, truncated
+ *
+ * @param[in]   path        path of the output file
+ * @param[in]   buffer_size bytes written to the file at once
+ * @return      whether opened or not
+ */
+bool BufferedWriter::Open(const string &path, size_t buffer_size) {
+    Close();
+    vector<char>(max(buffer_size, (size_t)WRITER_MIN_BUFFER_SIZE)).swap(buffer_);
+    fs_.open(path, ofstream::out | ofstream::binary);
+    return fs_.is_open();
+}
+
+/**
+ * Write the rest of the buffer and close the file
+ *
+ * @return      whether every byte has been written or not
+ */
+bool BufferedWriter::Close() {
+    if (fs_.is_open() == false) {
+        return true;
+    }
+    Flush();
+    bool good = fs_.good();
+    fs_.close();
+    return good;
+}
+
+void BufferedWriter::Flush() {
+    fs_.write(buffer_.data(), used_);
+    used_ = 0;
+}
+
+/**
+ * Make room for size bytes in the buffer
+ */
+void BufferedWriter::Reserve(size_t size) {
+    if (used_ + size > buffer_.size()) {
+        Flush();
+    }
+}
+
+void BufferedWriter::Write(const char *data, size_t size) {
+    if (size >= buffer_.size()) {
+        Flush();
+        fs_.write(data, size);
+        return;
+    }
+    Reserve(size);
+    memcpy(&buffer_[used_], data, size);
+    used_ += size;
+}
+
+void BufferedWriter::WriteInt(long value) {
+    char digits[24];
+    int len = 0;
+    unsigned long abs_value = value < 0 ? 0UL - value : value;
+    do {
+        digits[len++] = '0' + abs_value % 10;
+        abs_value /= 10;
+    } while (abs_value > 0);
+
+    Reserve(len + 1);
+    if (value < 0) {
+        buffer_[used_++] = '-';
+    }
+    while (len > 0) {
+        buffer_[used_++] = digits[--len];
+    }
+}
+
+/**
+ * Write a number as ostream does by default, 6 significant digits
+ */
+void BufferedWriter::WriteDouble(double value) {
+    Reserve(32);
+    used_ += snprintf(&buffer_[used_], 32, "%g", value);
+}